@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 
 #include <crypto/sha256.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <key.h>
 #include <validation.h>
 #include <util.h>
@@ -43,6 +44,7 @@ main(int argc, char** argv)
     }
 
     SHA256AutoDetect();
+    lyra2re2_autodetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -84,4 +84,32 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Fill a cache with many coins, look all of them up again and flush them, the
+// way the UTXO cache is used while connecting blocks during a sync.
+static void CCoinsCachingMany(benchmark::State& state)
+{
+    const int NUM_COINS = 100 * 1000;
+    CCoinsView coinsDummy;
+    CMutableTransaction tx;
+    tx.vout.resize(NUM_COINS);
+    for (CTxOut& txout : tx.vout) {
+        txout.nValue = 1;
+        txout.scriptPubKey << OP_1;
+    }
+    const uint256 txid = tx.GetHash();
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&coinsDummy);
+        for (int i = 0; i < NUM_COINS; i++) {
+            coins.AddCoin(COutPoint(txid, i), Coin(tx.vout[i], 1, false), false);
+        }
+        for (int i = 0; i < NUM_COINS; i++) {
+            bool have = coins.HaveCoinInCache(COutPoint(txid, i));
+            assert(have);
+        }
+        coins.Flush();
+    }
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCachingMany, 20);
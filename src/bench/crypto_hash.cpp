@@ -14,6 +14,8 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <crypto/Lyra2RE/Lyra2.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -60,6 +62,47 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+static void Lyra2REv2_80b(benchmark::State& state)
+{
+    std::vector<char> in(80,0);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        lyra2re2_hash(in.data(), reinterpret_cast<char*>(hash.begin()));
+        ++in[76];
+    }
+}
+
+static void Lyra2REv2_80b_scratch(benchmark::State& state)
+{
+    std::vector<char> in(80,0);
+    uint256 hash;
+    alignas(LYRA2RE2_SCRATCH_ALIGN) unsigned char scratch[LYRA2RE2_SCRATCH_SIZE];
+    while (state.KeepRunning()) {
+        lyra2re2_hash_scratch(in.data(), reinterpret_cast<char*>(hash.begin()), scratch);
+        ++in[76];
+    }
+}
+
+/* The Lyra2 stage of Lyra2REv2 on its own, where the allocations used to be */
+static void Lyra2_4x4(benchmark::State& state)
+{
+    uint256 in, hash;
+    while (state.KeepRunning()) {
+        LYRA2(hash.begin(), 32, in.begin(), 32, in.begin(), 32, 1, 4, 4);
+        ++*in.begin();
+    }
+}
+
+static void Lyra2_4x4_scratch(benchmark::State& state)
+{
+    uint256 in, hash;
+    alignas(LYRA2RE2_SCRATCH_ALIGN) unsigned char scratch[LYRA2RE2_SCRATCH_SIZE];
+    while (state.KeepRunning()) {
+        LYRA2_scratch(hash.begin(), 32, in.begin(), 32, in.begin(), 32, 1, 4, 4, scratch, sizeof(scratch));
+        ++*in.begin();
+    }
+}
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
@@ -93,6 +136,10 @@ BENCHMARK(SHA256, 340);
 BENCHMARK(SHA512, 330);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
+BENCHMARK(Lyra2REv2_80b, 200 * 1000);
+BENCHMARK(Lyra2REv2_80b_scratch, 200 * 1000);
+BENCHMARK(Lyra2_4x4, 1000 * 1000);
+BENCHMARK(Lyra2_4x4_scratch, 1000 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
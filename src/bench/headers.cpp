@@ -0,0 +1,121 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <streams.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <map>
+#include <memory>
+
+namespace headers_bench {
+#include <bench/data/regtest_headers2000.raw.h>
+} // namespace headers_bench
+
+// The costs of syncing and loading headers: accepting a full headers message
+// and reading the block index back at startup. The fixture is a chain of 2000
+// regtest headers on top of the regtest genesis block.
+
+static std::vector<CBlockHeader> LoadFixtureHeaders()
+{
+    CDataStream stream((const char*)headers_bench::regtest_headers2000,
+            (const char*)&headers_bench::regtest_headers2000[sizeof(headers_bench::regtest_headers2000)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<CBlockHeader> headers;
+    while (!stream.empty()) {
+        CBlockHeader header;
+        stream >> header;
+        headers.push_back(header);
+    }
+    assert(headers.size() == 2000);
+    return headers;
+}
+
+static void ProcessNewBlockHeaders2000(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const CChainParams& chainparams = Params();
+    const std::vector<CBlockHeader> headers = LoadFixtureHeaders();
+    const std::vector<CBlockHeader> genesis(1, chainparams.GenesisBlock().GetBlockHeader());
+    UnloadBlockIndex();
+
+    while (state.KeepRunning()) {
+        // Only the genesis header has to be in the index. Accepting it as a
+        // header keeps the block files out of the loop.
+        CValidationState validation_state;
+        bool ret = ProcessNewBlockHeaders(genesis, validation_state, chainparams);
+        assert(ret);
+
+        ret = ProcessNewBlockHeaders(headers, validation_state, chainparams);
+        assert(ret);
+        assert(pindexBestHeader->nHeight == 2000);
+
+        // Start over with an empty index, which is only memory to free
+        UnloadBlockIndex();
+    }
+}
+
+static void LoadBlockIndexGutsTest(benchmark::State& state, bool fCheckHashes)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const CChainParams& chainparams = Params();
+    const std::vector<CBlockHeader> headers = LoadFixtureHeaders();
+
+    // Write the index entries for the genesis block and the fixture
+    std::vector<CBlockHeader> chain(1, chainparams.GenesisBlock().GetBlockHeader());
+    chain.insert(chain.end(), headers.begin(), headers.end());
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> entries(chain.size());
+    std::vector<const CBlockIndex*> blockinfo;
+    for (size_t i = 0; i < chain.size(); i++) {
+        hashes.push_back(chain[i].GetHash());
+    }
+    for (size_t i = 0; i < chain.size(); i++) {
+        CBlockIndex& index = entries[i];
+        index = CBlockIndex(chain[i]);
+        index.phashBlock = &hashes[i];
+        index.pprev = i ? &entries[i - 1] : nullptr;
+        index.nHeight = i;
+        index.nStatus = BLOCK_VALID_TREE;
+        blockinfo.push_back(&index);
+    }
+    CBlockTreeDB blocktree(1 << 20, true);
+    bool ret = blocktree.WriteBatchSync({}, 0, blockinfo);
+    assert(ret);
+
+    while (state.KeepRunning()) {
+        std::map<uint256, std::unique_ptr<CBlockIndex>> loaded;
+        ret = blocktree.LoadBlockIndexGuts(chainparams.GetConsensus(), [&loaded](const uint256& hash) -> CBlockIndex* {
+            if (hash.IsNull())
+                return nullptr;
+            std::unique_ptr<CBlockIndex>& pindex = loaded[hash];
+            if (!pindex) {
+                pindex.reset(new CBlockIndex());
+                pindex->phashBlock = &loaded.find(hash)->first;
+            }
+            return pindex.get();
+        }, fCheckHashes, 0);
+        assert(ret);
+        assert(loaded.size() == chain.size());
+    }
+}
+
+static void LoadBlockIndexGuts2000(benchmark::State& state)
+{
+    LoadBlockIndexGutsTest(state, false);
+}
+
+static void LoadBlockIndexGuts2000_checkhashes(benchmark::State& state)
+{
+    LoadBlockIndexGutsTest(state, true);
+}
+
+BENCHMARK(ProcessNewBlockHeaders2000, 70);
+BENCHMARK(LoadBlockIndexGuts2000, 400);
+BENCHMARK(LoadBlockIndexGuts2000_checkhashes, 50);
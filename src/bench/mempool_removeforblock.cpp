@@ -0,0 +1,61 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/policy.h>
+#include <txmempool.h>
+
+#include <vector>
+
+static void AddTx(const CTransactionRef& tx, const CAmount& nFee, CTxMemPool& pool)
+{
+    int64_t nTime = 0;
+    unsigned int nHeight = 1;
+    bool spendsCoinbase = false;
+    unsigned int sigOpCost = 4;
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(
+                                         tx, nFee, nTime, nHeight,
+                                         spendsCoinbase, sigOpCost, lp, false));
+}
+
+// Connecting a block that confirms the first transactions of many long
+// unconfirmed chains, leaving the rest of each chain in the mempool. The
+// mempool is filled again on every run.
+static void MempoolRemoveForBlock(benchmark::State& state)
+{
+    const int nChains = 100;
+    const int nChainLength = 25;
+    const int nConfirmed = 20;
+
+    std::vector<CTransactionRef> vtxAll;
+    std::vector<CTransactionRef> vtxBlock;
+    for (int i = 0; i < nChains; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        for (int j = 0; j < nChainLength; j++) {
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            vtxAll.push_back(ptx);
+            if (j < nConfirmed) vtxBlock.push_back(ptx);
+            tx.vin[0].prevout = COutPoint(ptx->GetHash(), 0);
+            tx.vin[0].scriptSig = CScript() << OP_1;
+        }
+    }
+
+    while (state.KeepRunning()) {
+        CTxMemPool pool;
+        LOCK(pool.cs);
+        for (const CTransactionRef& tx : vtxAll) {
+            AddTx(tx, 1000LL, pool);
+        }
+        pool.removeForBlock(vtxBlock, 2);
+        assert(pool.size() == (unsigned int)(nChains * (nChainLength - nConfirmed)));
+    }
+}
+
+BENCHMARK(MempoolRemoveForBlock, 10);
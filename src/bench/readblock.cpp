@@ -0,0 +1,121 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <pow.h>
+#include <random.h>
+#include <streams.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+namespace block_bench {
+#include <bench/data/block413567.raw.h>
+} // namespace block_bench
+
+// Reading a block back through its index entry, as done by rescans, getblock,
+// serving blocks to peers and reorgs. The raw variants read the serialized
+// bytes, as done when serving witness blocks to peers.
+
+static void ReadBlockFromDiskTest(benchmark::State& state, CBlock block, unsigned int nMapFiles = 0, bool fRaw = false)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    // Give the block a header that is valid on regtest
+    block.nBits = UintToArith256(params.powLimit).GetCompact();
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, params))
+        ++block.nNonce;
+
+    ClearDatadirCache();
+    fs::path datadir = fs::temp_directory_path() / strprintf("bench_kusacoin_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    fs::create_directories(datadir);
+    gArgs.ForceSetArg("-datadir", datadir.string());
+
+    // Lay the block out as WriteBlockToDisk does, after the message start and size
+    CDiskBlockPos pos(0, 8);
+    {
+        CAutoFile fileout(OpenBlockFile(CDiskBlockPos(0, 0)), SER_DISK, CLIENT_VERSION);
+        assert(!fileout.IsNull());
+        fileout << FLATDATA(Params().MessageStart()) << (unsigned int)GetSerializeSize(fileout, block);
+        fileout << block;
+    }
+    uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA;
+
+    const unsigned int nOldMapFiles = nBlockMapFiles;
+    nBlockMapFiles = nMapFiles;
+    while (state.KeepRunning()) {
+        if (fRaw) {
+            std::vector<uint8_t> read;
+            bool ret = ReadRawBlockFromDisk(read, &index, Params().MessageStart());
+            assert(ret);
+        } else {
+            CBlock read;
+            bool ret = ReadBlockFromDisk(read, &index, params);
+            assert(ret);
+        }
+    }
+    nBlockMapFiles = nOldMapFiles;
+
+    ClearDatadirCache();
+    gArgs.ForceSetArg("-datadir", "");
+    fs::remove_all(datadir);
+}
+
+static void ReadBlockFromDiskSmall(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, CreateChainParams(CBaseChainParams::REGTEST)->GenesisBlock());
+}
+
+static CBlock LargeBlock()
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    return block;
+}
+
+static void ReadBlockFromDiskLarge(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, LargeBlock());
+}
+
+static void ReadBlockFromDiskMappedSmall(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, CreateChainParams(CBaseChainParams::REGTEST)->GenesisBlock(), 1);
+}
+
+static void ReadBlockFromDiskMappedLarge(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, LargeBlock(), 1);
+}
+
+static void ReadRawBlockFromDiskLarge(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, LargeBlock(), 0, true);
+}
+
+static void ReadRawBlockFromDiskMappedLarge(benchmark::State& state)
+{
+    ReadBlockFromDiskTest(state, LargeBlock(), 1, true);
+}
+
+BENCHMARK(ReadBlockFromDiskSmall, 20 * 1000);
+BENCHMARK(ReadBlockFromDiskLarge, 100);
+BENCHMARK(ReadBlockFromDiskMappedSmall, 20 * 1000);
+BENCHMARK(ReadBlockFromDiskMappedLarge, 100);
+BENCHMARK(ReadRawBlockFromDiskLarge, 100);
+BENCHMARK(ReadRawBlockFromDiskMappedLarge, 100);
@@ -142,10 +142,10 @@ enum BlockStatus: uint32_t {
     BLOCK_VALID_TRANSACTIONS =    3,
 
     //! Outputs do not overspend inputs, no double spends, coinbase output ok, no immature coinbase spends, BIP30.
-    //! Implies all parents are also at least CHAIN.
+    //! Implies all parents are also at least CHAIN, or BLOCK_ASSUMED_VALID.
     BLOCK_VALID_CHAIN        =    4,
 
-    //! Scripts & signatures ok. Implies all parents are also at least SCRIPTS.
+    //! Scripts & signatures ok. Implies all parents are also at least SCRIPTS, or BLOCK_ASSUMED_VALID.
     BLOCK_VALID_SCRIPTS      =    5,
 
     //! All validity bits.
@@ -161,6 +161,10 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    //! Connected by loading a UTXO snapshot committed to in the chain parameters, without
+    //! checking its inputs or scripts. Its validity stays at what was checked before.
+    BLOCK_ASSUMED_VALID     =   256,
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -60,6 +60,11 @@ void CChainParams::UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64
     consensus.vDeployments[d].nTimeout = nTimeout;
 }
 
+void CChainParams::UpdateUTXOSnapshot(const uint256& hashBlock, const uint256& hashFile)
+{
+    mapUTXOSnapshots[hashBlock] = hashFile;
+}
+
 /**
  * Main network
  */
@@ -308,3 +313,8 @@ void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime,
 {
     globalChainParams->UpdateVersionBitsParameters(d, nStartTime, nTimeout);
 }
+
+void UpdateUTXOSnapshot(const uint256& hashBlock, const uint256& hashFile)
+{
+    globalChainParams->UpdateUTXOSnapshot(hashBlock, hashFile);
+}
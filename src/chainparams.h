@@ -26,6 +26,9 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/** Block hash -> hash of the UTXO snapshot file for the state after that block */
+typedef std::map<uint256, uint256> MapUTXOSnapshots;
+
 struct ChainTxData {
     int64_t nTime;
     int64_t nTxCount;
@@ -71,7 +74,10 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    /** UTXO snapshots that may be loaded with loadtxoutset */
+    const MapUTXOSnapshots& UTXOSnapshots() const { return mapUTXOSnapshots; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
+    void UpdateUTXOSnapshot(const uint256& hashBlock, const uint256& hashFile);
 protected:
     CChainParams() {}
 
@@ -89,6 +95,7 @@ protected:
     bool fMineBlocksOnDemand;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapUTXOSnapshots mapUTXOSnapshots;
 };
 
 /**
@@ -115,4 +122,9 @@ void SelectParams(const std::string& chain);
  */
 void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
 
+/**
+ * Allows committing to a UTXO snapshot in unit tests.
+ */
+void UpdateUTXOSnapshot(const uint256& hashBlock, const uint256& hashFile);
+
 #endif // KUSACOIN_CHAINPARAMS_H
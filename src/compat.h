@@ -87,6 +87,15 @@ typedef int32_t ssize_t;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+// Wait for single sockets with poll(), and for all peers with epoll, which
+// unlike select() are not limited to sockets below FD_SETSIZE
+#ifdef HAVE_POLL_H
+#define USE_POLL
+#endif
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#define USE_EPOLL
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
 #ifdef WIN32
     return true;
@@ -44,6 +44,30 @@
  * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
  */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    const size_t scratchLen = LYRA2_SCRATCH_BYTES(nRows, nCols);
+    uint64_t *scratch = malloc(scratchLen);
+    if (scratch == NULL) {
+      return -1;
+    }
+
+    int ret = LYRA2_scratch(K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols, scratch, scratchLen);
+
+    free(scratch);
+    return ret;
+}
+
+/**
+ * Same as LYRA2(), but runs entirely inside a caller-owned scratch arena instead of allocating the
+ * memory matrix and the sponge state on the heap. The arena must be at least
+ * LYRA2_SCRATCH_BYTES(nRows, nCols) bytes long and suitably aligned for uint64_t (aligning it to a
+ * cache line is recommended). The arena is wiped before returning, so it can be reused right away.
+ *
+ * @param scratch Caller-owned scratch arena
+ * @param scratchLen Size of the scratch arena, in bytes
+ *
+ * @return 0 if the key is generated correctly; -1 if the scratch arena is too small
+ */
+int LYRA2_scratch(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols, void *scratch, size_t scratchLen) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -57,30 +81,23 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     //==========================================================================/
 
     //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
+    //The scratch arena holds the sponge state followed by the whole memory matrix
+    if (scratch == NULL || scratchLen < LYRA2_SCRATCH_BYTES(nRows, nCols)) {
+      return -1;
+    }
 
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
     const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
+    uint64_t *state = (uint64_t*) scratch;
+    uint64_t *wholeMatrix = state + LYRA2_STATE_INT64;
+
     i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
 	memset(wholeMatrix, 0, i);
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
-    }
+    //Rows are addressed directly inside the matrix instead of through a separately allocated pointer table
+#define ROW_PTR(r) (wholeMatrix + (r) * ROW_LEN_INT64)
+    uint64_t *ptrWord;
     //==========================================================================/
 
     //============= Getting the password + salt + basil padded with 10*1 ===============//
@@ -123,10 +140,6 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
     initState(state);
     //==========================================================================/
 
@@ -139,12 +152,12 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     }
 
     //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+    reducedSqueezeRow0(state, ROW_PTR(0), nCols); //The locally copied password is most likely overwritten here
+    reducedDuplexRow1(state, ROW_PTR(0), ROW_PTR(1), nCols);
 
     do {
       //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+      reducedDuplexRowSetup(state, ROW_PTR(prev), ROW_PTR(rowa), ROW_PTR(row), nCols);
 
 
       //updates the value of row* (deterministically picked during Setup))
@@ -177,7 +190,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
   	    //------------------------------------------------------------------------------------------
 
   	    //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-  	    reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+  	    reducedDuplexRow(state, ROW_PTR(prev), ROW_PTR(rowa), ROW_PTR(row), nCols);
 
   	    //update prev: it now points to the last row ever computed
   	    prev = row;
@@ -194,19 +207,16 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //============================ Wrap-up Phase ===============================//
     //Absorbs the last block of the memory matrix
-    absorbBlock(state, memMatrix[rowa]);
+    absorbBlock(state, ROW_PTR(rowa));
+#undef ROW_PTR
 
     //Squeezes the key
     squeeze(state, K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
-    memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
+    //========================= Wiping the scratch =============================//
+    //Wiping out the sponge's internal state and the matrix so nothing leaks into the next caller
+    memset(scratch, 0, LYRA2_SCRATCH_BYTES(nRows, nCols));
     //==========================================================================/
 
     return 0;
@@ -20,8 +20,13 @@
 #ifndef LYRA2_H_
 #define LYRA2_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef unsigned char byte;
 
 //Block length required so Blake2's Initialization Vector (IV) is not overwritten (THIS SHOULD NOT BE MODIFIED)
@@ -37,8 +42,20 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+//Sponge state: 16 uint64_t (THIS SHOULD NOT BE MODIFIED)
+#define LYRA2_STATE_INT64 16
+
+//Bytes of scratch needed by LYRA2_scratch(): the sponge state followed by the nRows x nCols memory matrix
+#define LYRA2_SCRATCH_BYTES(nRows, nCols) ((LYRA2_STATE_INT64 + (nRows) * (nCols) * BLOCK_LEN_INT64) * 8)
+
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
+int LYRA2_scratch(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols, void *scratch, size_t scratchLen);
+
 int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* LYRA2_H_ */
@@ -27,7 +27,12 @@
  * online backup system.
  */
 
+#if defined(HAVE_CONFIG_H)
+#include <config/kusacoin-config.h>
+#endif
+
 #include "Lyra2RE.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -39,6 +44,11 @@
 #include "sph_keccak.h"
 #include "sph_skein.h"
 #include "Lyra2.h"
+#include "Sponge.h"
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+#include <cpuid.h>
+#endif
 
 void lyra2re_hash(const char* input, char* output)
 {
@@ -70,7 +80,11 @@ void lyra2re_hash(const char* input, char* output)
 	memcpy(output, hashA, 32);
 }
 
-void lyra2re2_hash(const char* input, char* output)
+/* Compile-time check that LYRA2RE2_SCRATCH_SIZE covers LYRA2(..., 1, 4, 4) */
+typedef char lyra2re2_scratch_size_check[(LYRA2RE2_SCRATCH_SIZE >= LYRA2_SCRATCH_BYTES(4, 4)) ? 1 : -1];
+
+/* Runs the Lyra2REv2 chain; a NULL scratch makes LYRA2 allocate its own matrix */
+static void lyra2re2_hash_impl(const char* input, char* output, void* scratch)
 {
 	sph_blake256_context ctx_blake;
 	sph_cubehash256_context ctx_cubehash;
@@ -92,7 +106,10 @@ void lyra2re2_hash(const char* input, char* output)
     sph_cubehash256(&ctx_cubehash, hashB, 32);
     sph_cubehash256_close(&ctx_cubehash, hashA);
     
-    LYRA2(hashB, 32, hashA, 32, hashA, 32, 1, 4, 4);
+    if (scratch)
+        LYRA2_scratch(hashB, 32, hashA, 32, hashA, 32, 1, 4, 4, scratch, LYRA2RE2_SCRATCH_SIZE);
+    else
+        LYRA2(hashB, 32, hashA, 32, hashA, 32, 1, 4, 4);
     
    	sph_skein256_init(&ctx_skein);
     sph_skein256(&ctx_skein, hashB, 32); 
@@ -108,3 +125,103 @@ void lyra2re2_hash(const char* input, char* output)
     
    	memcpy(output, hashA, 32);
 }
+
+void lyra2re2_hash(const char* input, char* output)
+{
+    lyra2re2_hash_impl(input, output, NULL);
+}
+
+/* Allocation-free and reentrant variant of lyra2re2_hash(): all Lyra2 state lives
+ * in the caller-owned scratch arena of LYRA2RE2_SCRATCH_SIZE bytes, which must not
+ * be shared between concurrently running calls. */
+void lyra2re2_hash_scratch(const char* input, char* output, void* scratch)
+{
+    lyra2re2_hash_impl(input, output, scratch);
+}
+
+/* Mainnet and testnet genesis block headers with their Lyra2REv2 hashes */
+static const unsigned char selftest_in[2][80] = {
+    {
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x45, 0x7b, 0xac, 0x62, 0x92, 0xee, 0xfd, 0xce, 0x37, 0xa1, 0x80, 0x29,
+        0x72, 0x16, 0x3e, 0x3c, 0xb7, 0x38, 0x69, 0x20, 0xc9, 0xab, 0xf0, 0x5f, 0xd8, 0x1d, 0x1e, 0xf6,
+        0xcb, 0x2a, 0x0a, 0xd1, 0xf0, 0x26, 0x42, 0x5b, 0xff, 0xff, 0x00, 0x1e, 0xd3, 0x64, 0x98, 0x00
+    },
+    {
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x45, 0x7b, 0xac, 0x62, 0x92, 0xee, 0xfd, 0xce, 0x37, 0xa1, 0x80, 0x29,
+        0x72, 0x16, 0x3e, 0x3c, 0xb7, 0x38, 0x69, 0x20, 0xc9, 0xab, 0xf0, 0x5f, 0xd8, 0x1d, 0x1e, 0xf6,
+        0xcb, 0x2a, 0x0a, 0xd1, 0xf1, 0x26, 0x42, 0x5b, 0xff, 0xff, 0x00, 0x1e, 0x0d, 0xcc, 0x29, 0x00
+    }
+};
+
+static const unsigned char selftest_out[2][32] = {
+    {
+        0x8c, 0x6f, 0xea, 0x74, 0x12, 0x68, 0xbb, 0xe1, 0x98, 0xe3, 0xe8, 0x2f, 0xcf, 0x0a, 0x8a, 0xc8,
+        0x5c, 0x88, 0x06, 0x55, 0x17, 0x85, 0x49, 0xad, 0xc6, 0x87, 0x5e, 0xcb, 0x3a, 0x00, 0x00, 0x00
+    },
+    {
+        0x88, 0x28, 0x24, 0x0f, 0x9f, 0x82, 0x15, 0x13, 0x8e, 0xb2, 0x67, 0x60, 0x1d, 0x53, 0xe8, 0xca,
+        0xf3, 0xfd, 0x8f, 0x7a, 0x58, 0x15, 0x45, 0xe5, 0xaa, 0xbd, 0xa3, 0x32, 0x98, 0x00, 0x00, 0x00
+    }
+};
+
+/* Checks the currently installed round functions against known Lyra2REv2 hashes */
+static int lyra2re2_selftest(void)
+{
+    char out[32];
+    int i;
+    for (i = 0; i < 2; i++) {
+        lyra2re2_hash((const char*)selftest_in[i], out);
+        if (memcmp(out, selftest_out[i], 32) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+#if defined(ENABLE_AVX2) && !defined(BUILD_KUSACOIN_INTERNAL)
+/* Whether the OS saves the YMM registers on context switches */
+static int lyra2re2_avx_enabled(void)
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+#endif
+
+/* Selects the fastest round function implementations this CPU supports. Must be
+ * called before any hashing starts, as it replaces process-wide function pointers. */
+const char* lyra2re2_autodetect(void)
+{
+    const char* ret = "standard";
+    blake2bLyraRounds = blake2bLyraRounds_generic;
+    sph_cubehash_rounds = NULL;
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    uint32_t eax, ebx, ecx, edx;
+    (void)eax; (void)ebx; (void)ecx; (void)edx;
+#if defined(__SSE2__)
+    blake2bLyraRounds = blake2bLyraRounds_sse2;
+    sph_cubehash_rounds = sph_cubehash_rounds_sse2;
+    ret = "sse2";
+#endif
+#if defined(ENABLE_AVX2) && !defined(BUILD_KUSACOIN_INTERNAL)
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && lyra2re2_avx_enabled() &&
+        __get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if ((ebx >> 5) & 1) {
+            blake2bLyraRounds = blake2bLyraRounds_avx2;
+            sph_cubehash_rounds = sph_cubehash_rounds_avx2;
+            ret = "avx2";
+        }
+    }
+#endif
+#endif
+
+    assert(lyra2re2_selftest());
+    return ret;
+}
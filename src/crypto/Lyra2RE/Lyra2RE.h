@@ -5,8 +5,17 @@
 extern "C" {
 #endif
 
+/* Size of the scratch arena lyra2re2_hash_scratch() works in: the Lyra2 sponge
+ * state plus its 4x4 memory matrix. Callers should align it to a cache line. */
+#define LYRA2RE2_SCRATCH_SIZE 1664
+#define LYRA2RE2_SCRATCH_ALIGN 64
+
 void lyra2re_hash(const char* input, char* output);
 void lyra2re2_hash(const char* input, char* output);
+void lyra2re2_hash_scratch(const char* input, char* output, void* scratch);
+
+/* Autodetect the best available vectorized round functions. Returns the name of the implementation. */
+const char* lyra2re2_autodetect(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,129 @@
+/**
+ * AVX2 implementations of the Blake2b-based round function of the Lyra2
+ * sponge and of the CubeHash round function. They are selected at runtime by
+ * lyra2re2_autodetect() on CPUs (and operating systems) supporting AVX2.
+ *
+ * This software is hereby placed in the public domain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ''AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if defined(HAVE_CONFIG_H)
+#include <config/kusacoin-config.h>
+#endif
+
+#ifdef ENABLE_AVX2
+
+#include <immintrin.h>
+#include "Sponge.h"
+#include "sph_cubehash.h"
+
+#define ROTR64_AVX2(x, c) _mm256_xor_si256(_mm256_srli_epi64((x), (c)), _mm256_slli_epi64((x), 64 - (c)))
+#define ROTR64_32_AVX2(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+/*Blake2b's G function on all four columns (or diagonals) at once*/
+#define G_AVX2(a, b, c, d) \
+  do { \
+    a = _mm256_add_epi64(a, b); \
+    d = ROTR64_32_AVX2(_mm256_xor_si256(d, a)); \
+    c = _mm256_add_epi64(c, d); \
+    b = ROTR64_AVX2(_mm256_xor_si256(b, c), 24); \
+    a = _mm256_add_epi64(a, b); \
+    d = ROTR64_AVX2(_mm256_xor_si256(d, a), 16); \
+    c = _mm256_add_epi64(c, d); \
+    b = ROTR64_AVX2(_mm256_xor_si256(b, c), 63); \
+  } while(0)
+
+/**
+ * Applies "rounds" rounds of Blake2b's G function to the 1024-bit sponge state.
+ *
+ * @param v         A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
+ * @param rounds    Number of rounds (1 for the reduced-round permutation, 12 for the full one)
+ */
+void blake2bLyraRounds_avx2(uint64_t *v, unsigned rounds) {
+    __m256i row1 = _mm256_loadu_si256((const __m256i*)&v[0]);
+    __m256i row2 = _mm256_loadu_si256((const __m256i*)&v[4]);
+    __m256i row3 = _mm256_loadu_si256((const __m256i*)&v[8]);
+    __m256i row4 = _mm256_loadu_si256((const __m256i*)&v[12]);
+    unsigned r;
+
+    for (r = 0; r < rounds; r++) {
+        G_AVX2(row1, row2, row3, row4);
+        row2 = _mm256_permute4x64_epi64(row2, _MM_SHUFFLE(0, 3, 2, 1));
+        row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(1, 0, 3, 2));
+        row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(2, 1, 0, 3));
+        G_AVX2(row1, row2, row3, row4);
+        row2 = _mm256_permute4x64_epi64(row2, _MM_SHUFFLE(2, 1, 0, 3));
+        row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(1, 0, 3, 2));
+        row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+
+    _mm256_storeu_si256((__m256i*)&v[0], row1);
+    _mm256_storeu_si256((__m256i*)&v[4], row2);
+    _mm256_storeu_si256((__m256i*)&v[8], row3);
+    _mm256_storeu_si256((__m256i*)&v[12], row4);
+}
+
+#define ROTL32_AVX2(x, c) _mm256_or_si256(_mm256_slli_epi32((x), (c)), _mm256_srli_epi32((x), 32 - (c)))
+
+/*
+ * One CubeHash round. xa holds x_00000..x_00111, xb holds x_01000..x_01111,
+ * ya and yb the matching x_1jklm words. Swapping x_00klm with x_01klm is a
+ * register renaming, hence the operand order of the second call below;
+ * swapping x_0j0lm with x_0j1lm exchanges the 128-bit lanes.
+ */
+#define CUBEHASH_ROUND_AVX2(xa, xb, ya, yb) \
+  do { \
+    ya = _mm256_add_epi32(xa, ya); \
+    yb = _mm256_add_epi32(xb, yb); \
+    xa = ROTL32_AVX2(xa, 7); \
+    xb = ROTL32_AVX2(xb, 7); \
+    xb = _mm256_xor_si256(xb, ya); \
+    xa = _mm256_xor_si256(xa, yb); \
+    ya = _mm256_shuffle_epi32(ya, _MM_SHUFFLE(1, 0, 3, 2)); \
+    yb = _mm256_shuffle_epi32(yb, _MM_SHUFFLE(1, 0, 3, 2)); \
+    ya = _mm256_add_epi32(xb, ya); \
+    yb = _mm256_add_epi32(xa, yb); \
+    xa = ROTL32_AVX2(xa, 11); \
+    xb = ROTL32_AVX2(xb, 11); \
+    xa = _mm256_permute4x64_epi64(xa, _MM_SHUFFLE(1, 0, 3, 2)); \
+    xb = _mm256_permute4x64_epi64(xb, _MM_SHUFFLE(1, 0, 3, 2)); \
+    xb = _mm256_xor_si256(xb, ya); \
+    xa = _mm256_xor_si256(xa, yb); \
+    ya = _mm256_shuffle_epi32(ya, _MM_SHUFFLE(2, 3, 0, 1)); \
+    yb = _mm256_shuffle_epi32(yb, _MM_SHUFFLE(2, 3, 0, 1)); \
+  } while (0)
+
+/**
+ * Applies count times sixteen CubeHash rounds to the 32-word state,
+ * like SIXTEEN_ROUNDS in cubehash.c.
+ */
+void sph_cubehash_rounds_avx2(sph_u32 *state, unsigned count) {
+    __m256i xa = _mm256_loadu_si256((const __m256i*)&state[0]);
+    __m256i xb = _mm256_loadu_si256((const __m256i*)&state[8]);
+    __m256i ya = _mm256_loadu_si256((const __m256i*)&state[16]);
+    __m256i yb = _mm256_loadu_si256((const __m256i*)&state[24]);
+    unsigned r;
+
+    /* After one round, x_00klm lives in xb and x_01klm in xa; two rounds restore the order */
+    for (r = 0; r < 8 * count; r++) {
+        CUBEHASH_ROUND_AVX2(xa, xb, ya, yb);
+        CUBEHASH_ROUND_AVX2(xb, xa, ya, yb);
+    }
+
+    _mm256_storeu_si256((__m256i*)&state[0], xa);
+    _mm256_storeu_si256((__m256i*)&state[8], xb);
+    _mm256_storeu_si256((__m256i*)&state[16], ya);
+    _mm256_storeu_si256((__m256i*)&state[24], yb);
+}
+
+#endif /* ENABLE_AVX2 */
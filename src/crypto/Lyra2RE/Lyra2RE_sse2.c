@@ -0,0 +1,184 @@
+/**
+ * SSE2 implementations of the Lyra2REv2 building blocks that dominate its
+ * running time: the Blake2b-based round function of the Lyra2 sponge and the
+ * CubeHash round function. They are selected at runtime by
+ * lyra2re2_autodetect().
+ *
+ * The Blake2b round follows the SSE2 code path of the reference Blake2b
+ * implementation by Samuel Neves (https://blake2.net/).
+ *
+ * This software is hereby placed in the public domain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ''AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+#include "Sponge.h"
+#include "sph_cubehash.h"
+
+#define ROTR64_SSE2(x, c) _mm_xor_si128(_mm_srli_epi64((x), (c)), _mm_slli_epi64((x), 64 - (c)))
+#define ROTR64_32_SSE2(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+/*Blake2b's G function on two columns (or diagonals) at once*/
+#define G_SSE2(a, b, c, d) \
+  do { \
+    a = _mm_add_epi64(a, b); \
+    d = ROTR64_32_SSE2(_mm_xor_si128(d, a)); \
+    c = _mm_add_epi64(c, d); \
+    b = ROTR64_SSE2(_mm_xor_si128(b, c), 24); \
+    a = _mm_add_epi64(a, b); \
+    d = ROTR64_SSE2(_mm_xor_si128(d, a), 16); \
+    c = _mm_add_epi64(c, d); \
+    b = ROTR64_SSE2(_mm_xor_si128(b, c), 63); \
+  } while(0)
+
+#define DIAGONALIZE_SSE2(row2l, row3l, row4l, row2h, row3h, row4h) \
+  do { \
+    __m128i t0 = row4l; \
+    __m128i t1 = row2l; \
+    row4l = row3l; \
+    row3l = row3h; \
+    row3h = row4l; \
+    row4l = _mm_unpackhi_epi64(row4h, _mm_unpacklo_epi64(t0, t0)); \
+    row4h = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(row4h, row4h)); \
+    row2l = _mm_unpackhi_epi64(row2l, _mm_unpacklo_epi64(row2h, row2h)); \
+    row2h = _mm_unpackhi_epi64(row2h, _mm_unpacklo_epi64(t1, t1)); \
+  } while(0)
+
+#define UNDIAGONALIZE_SSE2(row2l, row3l, row4l, row2h, row3h, row4h) \
+  do { \
+    __m128i t0 = row3l; \
+    __m128i t1; \
+    row3l = row3h; \
+    row3h = t0; \
+    t0 = row2l; \
+    t1 = row4l; \
+    row2l = _mm_unpackhi_epi64(row2h, _mm_unpacklo_epi64(row2l, row2l)); \
+    row2h = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(row2h, row2h)); \
+    row4l = _mm_unpackhi_epi64(row4l, _mm_unpacklo_epi64(row4h, row4h)); \
+    row4h = _mm_unpackhi_epi64(row4h, _mm_unpacklo_epi64(t1, t1)); \
+  } while(0)
+
+/**
+ * Applies "rounds" rounds of Blake2b's G function to the 1024-bit sponge state.
+ *
+ * @param v         A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
+ * @param rounds    Number of rounds (1 for the reduced-round permutation, 12 for the full one)
+ */
+void blake2bLyraRounds_sse2(uint64_t *v, unsigned rounds) {
+    __m128i row1l = _mm_loadu_si128((const __m128i*)&v[0]);
+    __m128i row1h = _mm_loadu_si128((const __m128i*)&v[2]);
+    __m128i row2l = _mm_loadu_si128((const __m128i*)&v[4]);
+    __m128i row2h = _mm_loadu_si128((const __m128i*)&v[6]);
+    __m128i row3l = _mm_loadu_si128((const __m128i*)&v[8]);
+    __m128i row3h = _mm_loadu_si128((const __m128i*)&v[10]);
+    __m128i row4l = _mm_loadu_si128((const __m128i*)&v[12]);
+    __m128i row4h = _mm_loadu_si128((const __m128i*)&v[14]);
+    unsigned r;
+
+    for (r = 0; r < rounds; r++) {
+        G_SSE2(row1l, row2l, row3l, row4l);
+        G_SSE2(row1h, row2h, row3h, row4h);
+        DIAGONALIZE_SSE2(row2l, row3l, row4l, row2h, row3h, row4h);
+        G_SSE2(row1l, row2l, row3l, row4l);
+        G_SSE2(row1h, row2h, row3h, row4h);
+        UNDIAGONALIZE_SSE2(row2l, row3l, row4l, row2h, row3h, row4h);
+    }
+
+    _mm_storeu_si128((__m128i*)&v[0], row1l);
+    _mm_storeu_si128((__m128i*)&v[2], row1h);
+    _mm_storeu_si128((__m128i*)&v[4], row2l);
+    _mm_storeu_si128((__m128i*)&v[6], row2h);
+    _mm_storeu_si128((__m128i*)&v[8], row3l);
+    _mm_storeu_si128((__m128i*)&v[10], row3h);
+    _mm_storeu_si128((__m128i*)&v[12], row4l);
+    _mm_storeu_si128((__m128i*)&v[14], row4h);
+}
+
+#define ROTL32_SSE2(x, c) _mm_or_si128(_mm_slli_epi32((x), (c)), _mm_srli_epi32((x), 32 - (c)))
+
+/*
+ * One CubeHash round. x0..x3 hold x_00000..x_01111 and y0..y3 hold
+ * x_10000..x_11111; the swaps of x_0jklm words (steps 3 and 8 of the
+ * specification) are done by renaming registers, which is why the second
+ * half of the round uses its operands in a different order.
+ */
+#define CUBEHASH_ROUND_SSE2(x0, x1, x2, x3, y0, y1, y2, y3) \
+  do { \
+    y0 = _mm_add_epi32(x0, y0); \
+    y1 = _mm_add_epi32(x1, y1); \
+    y2 = _mm_add_epi32(x2, y2); \
+    y3 = _mm_add_epi32(x3, y3); \
+    x0 = ROTL32_SSE2(x0, 7); \
+    x1 = ROTL32_SSE2(x1, 7); \
+    x2 = ROTL32_SSE2(x2, 7); \
+    x3 = ROTL32_SSE2(x3, 7); \
+    x2 = _mm_xor_si128(x2, y0); \
+    x3 = _mm_xor_si128(x3, y1); \
+    x0 = _mm_xor_si128(x0, y2); \
+    x1 = _mm_xor_si128(x1, y3); \
+    y0 = _mm_shuffle_epi32(y0, _MM_SHUFFLE(1, 0, 3, 2)); \
+    y1 = _mm_shuffle_epi32(y1, _MM_SHUFFLE(1, 0, 3, 2)); \
+    y2 = _mm_shuffle_epi32(y2, _MM_SHUFFLE(1, 0, 3, 2)); \
+    y3 = _mm_shuffle_epi32(y3, _MM_SHUFFLE(1, 0, 3, 2)); \
+    y0 = _mm_add_epi32(x2, y0); \
+    y1 = _mm_add_epi32(x3, y1); \
+    y2 = _mm_add_epi32(x0, y2); \
+    y3 = _mm_add_epi32(x1, y3); \
+    x0 = ROTL32_SSE2(x0, 11); \
+    x1 = ROTL32_SSE2(x1, 11); \
+    x2 = ROTL32_SSE2(x2, 11); \
+    x3 = ROTL32_SSE2(x3, 11); \
+    x3 = _mm_xor_si128(x3, y0); \
+    x2 = _mm_xor_si128(x2, y1); \
+    x1 = _mm_xor_si128(x1, y2); \
+    x0 = _mm_xor_si128(x0, y3); \
+    y0 = _mm_shuffle_epi32(y0, _MM_SHUFFLE(2, 3, 0, 1)); \
+    y1 = _mm_shuffle_epi32(y1, _MM_SHUFFLE(2, 3, 0, 1)); \
+    y2 = _mm_shuffle_epi32(y2, _MM_SHUFFLE(2, 3, 0, 1)); \
+    y3 = _mm_shuffle_epi32(y3, _MM_SHUFFLE(2, 3, 0, 1)); \
+  } while (0)
+
+/**
+ * Applies count times sixteen CubeHash rounds to the 32-word state,
+ * like SIXTEEN_ROUNDS in cubehash.c.
+ */
+void sph_cubehash_rounds_sse2(sph_u32 *state, unsigned count) {
+    __m128i x0 = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i x1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    __m128i x2 = _mm_loadu_si128((const __m128i*)&state[8]);
+    __m128i x3 = _mm_loadu_si128((const __m128i*)&state[12]);
+    __m128i y0 = _mm_loadu_si128((const __m128i*)&state[16]);
+    __m128i y1 = _mm_loadu_si128((const __m128i*)&state[20]);
+    __m128i y2 = _mm_loadu_si128((const __m128i*)&state[24]);
+    __m128i y3 = _mm_loadu_si128((const __m128i*)&state[28]);
+    unsigned r;
+
+    /* After one round, x_0jklm lives in register x(j^1)(k^1); two rounds restore the order */
+    for (r = 0; r < 8 * count; r++) {
+        CUBEHASH_ROUND_SSE2(x0, x1, x2, x3, y0, y1, y2, y3);
+        CUBEHASH_ROUND_SSE2(x3, x2, x1, x0, y0, y1, y2, y3);
+    }
+
+    _mm_storeu_si128((__m128i*)&state[0], x0);
+    _mm_storeu_si128((__m128i*)&state[4], x1);
+    _mm_storeu_si128((__m128i*)&state[8], x2);
+    _mm_storeu_si128((__m128i*)&state[12], x3);
+    _mm_storeu_si128((__m128i*)&state[16], y0);
+    _mm_storeu_si128((__m128i*)&state[20], y1);
+    _mm_storeu_si128((__m128i*)&state[24], y2);
+    _mm_storeu_si128((__m128i*)&state[28], y3);
+}
+
+#endif /* __SSE2__ */
@@ -51,24 +51,28 @@ inline void initState(uint64_t state[/*16*/]) {
     state[15] = blake2b_IV[7];
 }
 
+/**
+ * Portable implementation of the Blake2b's G function rounds.
+ *
+ * @param v         A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
+ * @param rounds    Number of rounds to apply
+ */
+void blake2bLyraRounds_generic(uint64_t *v, unsigned rounds) {
+    unsigned r;
+    for (r = 0; r < rounds; r++) {
+        ROUND_LYRA(r);
+    }
+}
+
+void (*blake2bLyraRounds)(uint64_t *v, unsigned rounds) = blake2bLyraRounds_generic;
+
 /**
  * Execute Blake2b's G function, with all 12 rounds.
  *
  * @param v     A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
  */
 inline static void blake2bLyra(uint64_t *v) {
-    ROUND_LYRA(0);
-    ROUND_LYRA(1);
-    ROUND_LYRA(2);
-    ROUND_LYRA(3);
-    ROUND_LYRA(4);
-    ROUND_LYRA(5);
-    ROUND_LYRA(6);
-    ROUND_LYRA(7);
-    ROUND_LYRA(8);
-    ROUND_LYRA(9);
-    ROUND_LYRA(10);
-    ROUND_LYRA(11);
+    blake2bLyraRounds(v, 12);
 }
 
 /**
@@ -76,7 +80,7 @@ inline static void blake2bLyra(uint64_t *v) {
  * @param v     A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
  */
 inline static void reducedBlake2bLyra(uint64_t *v) {
-    ROUND_LYRA(0);
+    blake2bLyraRounds(v, 1);
 }
 
 /**
@@ -73,6 +73,14 @@ static inline uint64_t rotr64( const uint64_t w, const unsigned c ){
     G(r,7,v[ 3],v[ 4],v[ 9],v[14]);
 
 
+//---- Round function
+//Applies "rounds" rounds of Blake2b's G function to the state; points to the fastest
+//implementation available on this CPU once lyra2re2_autodetect() has run
+extern void (*blake2bLyraRounds)(uint64_t *v, unsigned rounds);
+void blake2bLyraRounds_generic(uint64_t *v, unsigned rounds);
+void blake2bLyraRounds_sse2(uint64_t *v, unsigned rounds);
+void blake2bLyraRounds_avx2(uint64_t *v, unsigned rounds);
+
 //---- Housekeeping
 void initState(uint64_t state[/*16*/]);
 
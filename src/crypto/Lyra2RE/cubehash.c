@@ -528,6 +528,38 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+/* see sph_cubehash.h */
+void (*sph_cubehash_rounds)(sph_u32 *state, unsigned count) = NULL;
+
+static void
+cubehash_core_vec(sph_cubehash_context *sc, const void *data, size_t len)
+{
+	unsigned char *buf;
+	size_t ptr;
+	int i;
+
+	buf = sc->buf;
+	ptr = sc->ptr;
+	while (len > 0) {
+		size_t clen;
+
+		clen = (sizeof sc->buf) - ptr;
+		if (clen > len)
+			clen = len;
+		memcpy(buf + ptr, data, clen);
+		ptr += clen;
+		data = (const unsigned char *)data + clen;
+		len -= clen;
+		if (ptr == sizeof sc->buf) {
+			for (i = 0; i < 8; i ++)
+				sc->state[i] ^= sph_dec32le_aligned(buf + 4 * i);
+			sph_cubehash_rounds(sc->state, 1);
+			ptr = 0;
+		}
+	}
+	sc->ptr = ptr;
+}
+
 static void
 cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 {
@@ -551,6 +583,11 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		return;
 	}
 
+	if (sph_cubehash_rounds != NULL) {
+		cubehash_core_vec(sc, data, len);
+		return;
+	}
+
 	READ_STATE(sc);
 	while (len > 0) {
 		size_t clen;
@@ -587,14 +624,22 @@ cubehash_close(sph_cubehash_context *sc, unsigned ub, unsigned n,
 	z = 0x80 >> n;
 	buf[ptr ++] = ((ub & -z) | z) & 0xFF;
 	memset(buf + ptr, 0, (sizeof sc->buf) - ptr);
-	READ_STATE(sc);
-	INPUT_BLOCK;
-	for (i = 0; i < 11; i ++) {
-		SIXTEEN_ROUNDS;
-		if (i == 0)
-			xv ^= SPH_C32(1);
+	if (sph_cubehash_rounds != NULL) {
+		for (i = 0; i < 8; i ++)
+			sc->state[i] ^= sph_dec32le_aligned(buf + 4 * i);
+		sph_cubehash_rounds(sc->state, 1);
+		sc->state[31] ^= SPH_C32(1);
+		sph_cubehash_rounds(sc->state, 10);
+	} else {
+		READ_STATE(sc);
+		INPUT_BLOCK;
+		for (i = 0; i < 11; i ++) {
+			SIXTEEN_ROUNDS;
+			if (i == 0)
+				xv ^= SPH_C32(1);
+		}
+		WRITE_STATE(sc);
 	}
-	WRITE_STATE(sc);
 	out = dst;
 	for (z = 0; z < out_size_w32; z ++)
 		sph_enc32le(out + (z << 2), sc->state[z]);
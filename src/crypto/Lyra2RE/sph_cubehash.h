@@ -282,5 +282,15 @@ void sph_cubehash512_close(void *cc, void *dst);
 void sph_cubehash512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/**
+ * Optional vectorized replacement for the CubeHash round function: when
+ * non-NULL, it is called to apply <code>count</code> times sixteen rounds
+ * to the 32-word state. It is installed by <code>lyra2re2_autodetect()</code>
+ * and must only be changed before any hashing starts.
+ */
+extern void (*sph_cubehash_rounds)(sph_u32 *state, unsigned count);
+void sph_cubehash_rounds_sse2(sph_u32 *state, unsigned count);
+void sph_cubehash_rounds_avx2(sph_u32 *state, unsigned count);
+
 #endif
 
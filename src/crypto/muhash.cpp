@@ -0,0 +1,116 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/sha256.h>
+
+#include <string.h>
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limbs[i] = 0;
+        for (size_t j = 0; j < sizeof(limb_t); ++j) {
+            limbs[i] |= (limb_t)data[i * sizeof(limb_t) + j] << (8 * j);
+        }
+    }
+    if (IsOverflow()) FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+bool Num3072::IsOverflow() const
+{
+    // Whether the number is at least the prime, which is all ones except for the lowest limb
+    if (limbs[0] <= (limb_t)(-MAX_PRIME_DIFF - 1)) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != (limb_t)-1) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the prime is adding MAX_PRIME_DIFF and dropping 2^3072
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += limbs[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook multiplication into twice the number of limbs
+    limb_t tmp[LIMBS * 2];
+    memset(tmp, 0, sizeof(tmp));
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t c = (double_limb_t)limbs[i] * a.limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)c;
+            carry = (limb_t)(c >> LIMB_SIZE);
+        }
+        tmp[i + LIMBS] = carry;
+    }
+
+    // Fold the upper half back in, as 2^3072 is MAX_PRIME_DIFF modulo the prime
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t c = (double_limb_t)tmp[i + LIMBS] * MAX_PRIME_DIFF + tmp[i] + carry;
+        limbs[i] = (limb_t)c;
+        carry = (limb_t)(c >> LIMB_SIZE);
+    }
+    while (carry) {
+        double_limb_t c = (double_limb_t)carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; ++i) {
+            c += limbs[i];
+            limbs[i] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+        carry = (limb_t)c;
+    }
+    if (IsOverflow()) FullReduce();
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        for (size_t j = 0; j < sizeof(limb_t); ++j) {
+            out[i * sizeof(limb_t) + j] = (unsigned char)(limbs[i] >> (8 * j));
+        }
+    }
+}
+
+MuHash3072::MuHash3072(const unsigned char* in, size_t len)
+{
+    // Expand the SHA256 of the string to a 3072 bit number
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(in, len).Finalize(key);
+    unsigned char expanded[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(expanded, sizeof(expanded));
+    data = Num3072(expanded);
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& x)
+{
+    data.Multiply(x.data);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    data.ToBytes(bytes);
+    CSHA256().Write(bytes, sizeof(bytes)).Finalize(hash);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KUSACOIN_CRYPTO_MUHASH_H
+#define KUSACOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static const size_t BYTE_SIZE = 384;
+    static const int LIMB_SIZE = 8 * sizeof(limb_t);
+    static const int LIMBS = 3072 / LIMB_SIZE;
+    //! The prime is 2^3072 - MAX_PRIME_DIFF
+    static const limb_t MAX_PRIME_DIFF = 1103717;
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    //! Read a little endian number, reducing it modulo the prime
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A hash of a set of byte strings, which does not depend on the order in
+ * which they were added (MuHash). Each string is hashed to a number modulo a
+ * 3072 bit prime, and the numbers are multiplied. Hashes of disjoint sets can
+ * be combined by multiplying them, which lets a set be hashed in parts on
+ * several threads.
+ *
+ * Unlike a sum or xor of hashes, finding two sets with the same hash is as
+ * hard as a discrete logarithm in this group.
+ */
+class MuHash3072
+{
+private:
+    Num3072 data;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The hash of the empty set
+    MuHash3072() {}
+    //! The hash of a set with just this string
+    MuHash3072(const unsigned char* in, size_t len);
+
+    //! Combine with the hash of a disjoint set
+    MuHash3072& operator*=(const MuHash3072& x);
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+};
+
+#endif // KUSACOIN_CRYPTO_MUHASH_H
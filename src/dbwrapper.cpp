@@ -13,7 +13,9 @@
 #include <leveldb/filter_policy.h>
 #include <memenv.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <algorithm>
+#include <sstream>
 
 class CKusacoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -73,14 +75,17 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(const CDBOptions& db_options)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache(db_options.nCacheSize / 2);
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = db_options.nWriteBufferSize ? db_options.nWriteBufferSize : db_options.nCacheSize / 4;
+    options.block_size = db_options.nBlockSize;
+    options.max_file_size = db_options.nMaxFileSize;
+    options.filter_policy = db_options.nBloomBitsPerKey > 0 ? leveldb::NewBloomFilterPolicy(db_options.nBloomBitsPerKey) : nullptr;
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = db_options.nMaxOpenFiles;
     options.info_log = new CKusacoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -91,13 +96,18 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 }
 
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+    : CDBWrapper(path, CDBOptions(nCacheSize), fMemory, fWipe, obfuscate)
+{
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, const CDBOptions& db_options_in, bool fMemory, bool fWipe, bool obfuscate) : db_options(db_options_in)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(db_options);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -189,6 +199,53 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+//! A key after all keys of the databases, which are much shorter
+static const std::string LAST_KEY(DBWRAPPER_PREALLOC_KEY_SIZE, '\xff');
+
+size_t CDBWrapper::EstimateRawSize(const std::string& begin, const std::string& end) const
+{
+    uint64_t size = 0;
+    leveldb::Range range(begin, end.empty() ? LAST_KEY : end);
+    pdb->GetApproximateSizes(&range, 1, &size);
+    return size;
+}
+
+void CDBWrapper::CompactRawRange(const std::string& begin, const std::string& end) const
+{
+    leveldb::Slice slBegin(begin), slEnd(end);
+    pdb->CompactRange(begin.empty() ? nullptr : &slBegin, end.empty() ? nullptr : &slEnd);
+}
+
+std::string CDBWrapper::GetProperty(const std::string& name) const
+{
+    std::string value;
+    if (!pdb->GetProperty(name, &value)) {
+        return std::string();
+    }
+    return value;
+}
+
+size_t CDBWrapper::GetMemoryUsage() const
+{
+    return atoi64(GetProperty("leveldb.approximate-memory-usage"));
+}
+
+std::vector<CDBLevelStats> CDBWrapper::GetLevelStats() const
+{
+    // leveldb.stats is a table with a three line header and a row per level
+    std::vector<CDBLevelStats> levels;
+    std::istringstream stats(GetProperty("leveldb.stats"));
+    std::string line;
+    for (int i = 0; std::getline(stats, line); i++) {
+        CDBLevelStats level;
+        if (i >= 3 && sscanf(line.c_str(), "%d %d %lf %lf %lf %lf", &level.nLevel, &level.nFiles, &level.dSizeMiB,
+                &level.dCompactionSeconds, &level.dReadMiB, &level.dWrittenMiB) == 6) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
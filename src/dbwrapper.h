@@ -28,6 +28,33 @@ public:
 
 class CDBWrapper;
 
+/** LevelDB tuning of one database */
+struct CDBOptions {
+    //! Memory for the block cache and, unless nWriteBufferSize is set, the write buffers
+    size_t nCacheSize;
+    //! Size of a write buffer, two of which may be in memory at once (0 = a quarter of nCacheSize)
+    size_t nWriteBufferSize = 0;
+    //! Approximate size of the uncompressed data in a table block
+    size_t nBlockSize = 4096;
+    //! Size at which a table file is closed and a new one started
+    size_t nMaxFileSize = 2 << 20;
+    int nMaxOpenFiles = 64;
+    //! Bits per key of the bloom filters (0 = no bloom filters)
+    int nBloomBitsPerKey = 10;
+
+    explicit CDBOptions(size_t nCacheSizeIn) : nCacheSize(nCacheSizeIn) {}
+};
+
+/** Compaction statistics of one level of a LevelDB database */
+struct CDBLevelStats {
+    int nLevel;
+    int nFiles;
+    double dSizeMiB;
+    double dCompactionSeconds;
+    double dReadMiB;
+    double dWrittenMiB;
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -183,6 +210,7 @@ private:
 
     //! database options used
     leveldb::Options options;
+    CDBOptions db_options;
 
     //! options used when reading from the database
     leveldb::ReadOptions readoptions;
@@ -220,6 +248,7 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, const CDBOptions& db_options, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -323,6 +352,9 @@ public:
         return size;
     }
 
+    //! Estimate the size on disk of the serialized keys from begin to end (empty = to the last key)
+    size_t EstimateRawSize(const std::string& begin, const std::string& end) const;
+
     /**
      * Compact a certain range of keys in the database.
      */
@@ -339,6 +371,17 @@ public:
         pdb->CompactRange(&slKey1, &slKey2);
     }
 
+    //! Compact the serialized keys from begin to end, where empty means the first or last key
+    void CompactRawRange(const std::string& begin, const std::string& end) const;
+
+    const CDBOptions& GetDBOptions() const { return db_options; }
+
+    //! Value of a LevelDB property such as "leveldb.stats", or an empty string if it does not exist
+    std::string GetProperty(const std::string& name) const;
+    //! Approximate memory used by the memtables and the block cache
+    size_t GetMemoryUsage() const;
+    //! The compaction statistics of the levels that are used
+    std::vector<CDBLevelStats> GetLevelStats() const;
 };
 
 #endif // KUSACOIN_DBWRAPPER_H
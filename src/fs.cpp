@@ -1,5 +1,14 @@
 #include <fs.h>
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace fsbridge {
 
 FILE *fopen(const fs::path& p, const char *mode)
@@ -12,4 +21,51 @@ FILE *freopen(const fs::path& p, const char *mode, FILE *stream)
     return ::freopen(p.string().c_str(), mode, stream);
 }
 
+#ifdef WIN32
+MappedFile::MappedFile(const fs::path& p)
+{
+    HANDLE hFile = CreateFileW(p.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER nFileSize;
+    if (GetFileSizeEx(hFile, &nFileSize) && nFileSize.QuadPart > 0) {
+        HANDLE hMap = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (hMap != nullptr) {
+            void* addr = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+            if (addr != nullptr) {
+                data = static_cast<const unsigned char*>(addr);
+                nSize = nFileSize.QuadPart;
+            }
+            CloseHandle(hMap);
+        }
+    }
+    CloseHandle(hFile);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data) UnmapViewOfFile(data);
+}
+#else
+MappedFile::MappedFile(const fs::path& p)
+{
+    int fd = ::open(p.string().c_str(), O_RDONLY);
+    if (fd == -1) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(addr);
+            nSize = st.st_size;
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data) munmap(const_cast<unsigned char*>(data), nSize);
+}
+#endif
+
 } // fsbridge
@@ -20,6 +20,25 @@ namespace fs = boost::filesystem;
 namespace fsbridge {
     FILE *fopen(const fs::path& p, const char *mode);
     FILE *freopen(const fs::path& p, const char *mode, FILE *stream);
+
+    /** Read-only memory mapping of a whole file, as large as the file was when it was mapped */
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const fs::path& p);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool IsNull() const { return data == nullptr; }
+        const unsigned char* begin() const { return data; }
+        size_t size() const { return nSize; }
+
+    private:
+        const unsigned char* data = nullptr;
+        size_t nSize = 0;
+    };
 };
 
 #endif // KUSACOIN_FS_H
@@ -12,6 +12,12 @@ inline uint32_t ROTL32(uint32_t x, int8_t r)
     return (x << r) | (x >> (32 - r));
 }
 
+void* GetLyra2REv2ThreadScratch()
+{
+    alignas(LYRA2RE2_SCRATCH_ALIGN) static thread_local unsigned char scratch[LYRA2RE2_SCRATCH_SIZE];
+    return scratch;
+}
+
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
 {
     // The following is MurmurHash3 (x86_32), see http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
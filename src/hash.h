@@ -148,6 +148,11 @@ public:
     }
 };
 
+/** Per-thread, cache-line aligned scratch arena for lyra2re2_hash_scratch(). */
+void* GetLyra2REv2ThreadScratch();
+
+/** A writer stream (for serialization) that computes the Lyra2REv2 hash of an
+ * 80-byte block header without touching the heap. */
 class CHashLyra2LEv2Writer
 {
 private:
@@ -161,9 +166,9 @@ public:
             data[n++] = pch[i];
     }
 
-    uint256 GetHash() {
+    uint256 GetHash(void* scratch = nullptr) {
         uint256 result;
-        lyra2re2_hash(data, reinterpret_cast<char *>(&result));
+        lyra2re2_hash_scratch(data, reinterpret_cast<char *>(&result), scratch ? scratch : GetLyra2REv2ThreadScratch());
         return result;
     }
 
@@ -209,6 +214,31 @@ public:
     }
 };
 
+/** Writes data to a sink, and computes the hash of everything written. */
+template<typename Sink>
+class CHashedWriter : public CHashWriter
+{
+private:
+    Sink* sink;
+
+public:
+    explicit CHashedWriter(Sink* sink_) : CHashWriter(sink_->GetType(), sink_->GetVersion()), sink(sink_) {}
+
+    void write(const char* pch, size_t nSize)
+    {
+        sink->write(pch, nSize);
+        CHashWriter::write(pch, nSize);
+    }
+
+    template<typename T>
+    CHashedWriter<Sink>& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
 /** Compute the 256-bit hash of an object's serialization. */
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
@@ -17,6 +17,7 @@
 #include <checkpoints.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
@@ -192,6 +193,8 @@ void Shutdown()
 #ifdef ENABLE_WALLET
     FlushWallets();
 #endif
+    // The miner threads use the connection manager and submit blocks, stop them first
+    GenerateKusacoins(false, 0, CScript(), Params());
     MapPort(false);
 
     // Because these depend on each-other, we make sure that neither can be
@@ -357,6 +360,17 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbcachekeep=<n>", strprintf(_("Percentage of the in-memory UTXO set to keep when it is written to disk, oldest coins are dropped first (0 to %d, 0 = empty it, default: %d)"), nMaxDbCacheKeep, nDefaultDbCacheKeep));
+    if (showDebug) {
+        const CDBOptions db_defaults(0);
+        for (const std::string db : {"chainstate", "blockindex"}) {
+            strUsage += HelpMessageOpt("-" + db + "writebuffer=<n>", strprintf("Size of a LevelDB write buffer of the %s database in MiB (0 = a quarter of its cache, default: %u)", db, db_defaults.nWriteBufferSize >> 20));
+            strUsage += HelpMessageOpt("-" + db + "blocksize=<n>", strprintf("Size of the LevelDB table blocks of the %s database in KiB (default: %u)", db, db_defaults.nBlockSize >> 10));
+            strUsage += HelpMessageOpt("-" + db + "filesize=<n>", strprintf("Size of the LevelDB table files of the %s database in MiB (default: %u)", db, db_defaults.nMaxFileSize >> 20));
+            strUsage += HelpMessageOpt("-" + db + "maxopenfiles=<n>", strprintf("Number of files the %s database keeps open (default: %u)", db, db_defaults.nMaxOpenFiles));
+            strUsage += HelpMessageOpt("-" + db + "bloombits=<n>", strprintf("Bits per key of the bloom filters of the %s database (0 = none, default: %u)", db, db_defaults.nBloomBitsPerKey));
+        }
+    }
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
@@ -368,9 +382,12 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()));
     }
     strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
+    strUsage += HelpMessageOpt("-blockmmap=<n>", strprintf(_("Read blocks through memory mappings of the <n> most recently read block files (0 = off, default: %u)"), DEFAULT_BLOCK_MMAP_FILES));
+    strUsage += HelpMessageOpt("-blockwritequeue=<n>", strprintf(_("Write blocks and undo data to disk on a separate thread, queueing up to <n> MiB of them (0 = write synchronously, default: %u)"), DEFAULT_BLOCK_WRITE_QUEUE));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-prefetchcoins", strprintf(_("Read the coins spent by a new block from the database on the script verification threads before connecting it (default: %u)"), DEFAULT_PREFETCH_COINS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), KUSACOIN_PID_FILENAME));
 #endif
@@ -401,6 +418,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msghandlers=<n>", strprintf(_("Set the number of threads processing peer messages (1 to %d, default: %d)"), MAX_MSG_HANDLER_THREADS, DEFAULT_MSG_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -409,6 +427,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+#ifdef USE_EPOLL
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Wait for socket events with <mode>: select or epoll (default: %s)"), "epoll"));
+#else
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Wait for socket events with <mode>: select (default: %s)"), "select"));
+#endif
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -443,6 +466,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindexhashes", strprintf("Recompute the hash of every block index entry at startup instead of trusting the database key (default: %u)", DEFAULT_CHECKBLOCKINDEXHASHES));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
@@ -452,12 +476,14 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-fuzzmessagestest=<n>", "Randomly fuzz 1 of every <n> network messages");
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT));
         strUsage += HelpMessageOpt("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT));
+        strUsage += HelpMessageOpt("-maxconnectheight", strprintf("Do not connect blocks above the given height to the main chain, 0 for no limit (regtest-only, default: %u)", DEFAULT_MAXCONNECTHEIGHT));
 
         strUsage += HelpMessageOpt("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT));
         strUsage += HelpMessageOpt("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-vbparams=deployment:start:end", "Use given start/end times for specified version bits deployment (regtest-only)");
+        strUsage += HelpMessageOpt("-assumeutxo=<blockhash>:<filehash>", "Accept the UTXO snapshot of the given block with the given file hash in loadtxoutset (regtest-only)");
     }
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
         _("If <category> is not supplied or if <category> = 1, output all debugging information.") + " " + _("<category> can be:") + " " + ListLogCategories() + ".");
@@ -832,6 +858,7 @@ namespace { // Variables internal to initialization process only
 int nMaxConnections;
 int nUserMaxConnections;
 int nFD;
+SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 
 } // namespace
@@ -918,13 +945,24 @@ bool AppInitParameterInteraction()
         return InitError("Cannot set -bind or -whitebind together with -listen=0");
     }
 
+    // Pick how the socket thread waits for events, select() limits the descriptors usable
+    if (gArgs.IsArgSet("-socketevents")) {
+        std::string strMode = gArgs.GetArg("-socketevents", "");
+        if (!ParseSocketEventsMode(strMode, socketEventsMode)) {
+            return InitError(strprintf(_("Unsupported -socketevents mode '%s'"), strMode));
+        }
+    }
+    // Only select() cannot wait on sockets at or above FD_SETSIZE
+    fRequireSelectableSockets = socketEventsMode == SOCKETEVENTS_SELECT;
+
     // Make sure enough file descriptors are available
     int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections = gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -986,7 +1024,11 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    fCheckBlockIndexHashes = gArgs.GetBoolArg("-checkblockindexhashes", DEFAULT_CHECKBLOCKINDEXHASHES);
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fPrefetchCoins = gArgs.GetBoolArg("-prefetchcoins", DEFAULT_PREFETCH_COINS);
+    nBlockWriteQueueSize = (size_t)std::max<int64_t>(0, gArgs.GetArg("-blockwritequeue", DEFAULT_BLOCK_WRITE_QUEUE)) << 20;
+    nBlockMapFiles = std::max<int64_t>(0, gArgs.GetArg("-blockmmap", DEFAULT_BLOCK_MMAP_FILES));
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1013,6 +1055,12 @@ bool AppInitParameterInteraction()
     int64_t nMempoolSizeMin = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
     if (nMempoolSizeMax < 0 || nMempoolSizeMax < nMempoolSizeMin)
         return InitError(strprintf(_("-maxmempool must be at least %d MB"), std::ceil(nMempoolSizeMin / 1000000.0)));
+
+    // LevelDB needs to keep at least one table file open
+    for (const std::string db : {"chainstate", "blockindex"}) {
+        if (gArgs.GetArg("-" + db + "maxopenfiles", 1) < 1)
+            return InitError(strprintf(_("-%smaxopenfiles must be at least 1"), db));
+    }
     // incremental relay fee sets the minimum feerate increase necessary for BIP 125 replacement in the mempool
     // and the amount the mempool min fee increases above the feerate of txs evicted due to mempool limiting.
     if (gArgs.IsArgSet("-incrementalrelayfee"))
@@ -1154,6 +1202,31 @@ bool AppInitParameterInteraction()
             }
         }
     }
+
+    if (gArgs.IsArgSet("-maxconnectheight") && !chainparams.MineBlocksOnDemand()) {
+        return InitError("The height up to which blocks are connected may only be limited on regtest.");
+    }
+
+    if (gArgs.IsArgSet("-assumeutxo")) {
+        // Allow adding UTXO snapshots for testing
+        if (!chainparams.MineBlocksOnDemand()) {
+            return InitError("UTXO snapshots may only be added on regtest.");
+        }
+        for (const std::string& strSnapshot : gArgs.GetArgs("-assumeutxo")) {
+            std::vector<std::string> vSnapshotParams;
+            boost::split(vSnapshotParams, strSnapshot, boost::is_any_of(":"));
+            if (vSnapshotParams.size() != 2) {
+                return InitError("UTXO snapshot malformed, expecting blockhash:filehash");
+            }
+            for (const std::string& strHash : vSnapshotParams) {
+                if (strHash.size() != 64 || !IsHex(strHash)) {
+                    return InitError(strprintf("Invalid UTXO snapshot hash (%s)", strHash));
+                }
+            }
+            UpdateUTXOSnapshot(uint256S(vSnapshotParams[0]), uint256S(vSnapshotParams[1]));
+            LogPrintf("Accepting UTXO snapshot of block %s with hash %s\n", vSnapshotParams[0], vSnapshotParams[1]);
+        }
+    }
     return true;
 }
 
@@ -1174,6 +1247,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string lyra2_algo = lyra2re2_autodetect();
+    LogPrintf("Using the '%s' Lyra2REv2 implementation\n", lyra2_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1242,6 +1317,13 @@ bool AppInitMain()
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        if (fPrefetchCoins) {
+            for (int i=0; i<nScriptCheckThreads-1; i++)
+                threadGroup.create_thread(&ThreadCoinsPrefetch);
+        }
+    }
+    if (nBlockWriteQueueSize) {
+        threadGroup.create_thread(&ThreadBlockFileWriter);
     }
 
     // Start the lightweight task scheduler thread
@@ -1407,11 +1489,16 @@ bool AppInitMain()
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    int nCoinCacheKeep = std::max(0, std::min<int>(gArgs.GetArg("-dbcachekeep", nDefaultDbCacheKeep), nMaxDbCacheKeep));
+    nCoinCacheKeepUsage = nCoinCacheUsage / 100 * nCoinCacheKeep;
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    if (nCoinCacheKeepUsage > 0) {
+        LogPrintf("* Keeping up to %.1fMiB of the in-memory UTXO set when writing it to disk\n", nCoinCacheKeepUsage * (1.0 / 1024 / 1024));
+    }
 
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
@@ -1686,6 +1773,8 @@ bool AppInitMain()
     connOptions.uiInterface = &uiInterface;
     connOptions.m_msgproc = peerLogic.get();
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
+    connOptions.socketEventsMode = socketEventsMode;
+    connOptions.nMsgHandlerThreads = gArgs.GetArg("-msghandlers", DEFAULT_MSG_HANDLER_THREADS);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
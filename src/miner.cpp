@@ -7,6 +7,7 @@
 #include <miner.h>
 
 #include <amount.h>
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <coins.h>
@@ -14,6 +15,8 @@
 #include <consensus/tx_verify.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <hash.h>
 #include <validation.h>
 #include <net.h>
@@ -22,16 +25,22 @@
 #include <pow.h>
 #include <primitives/transaction.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <timedata.h>
 #include <util.h>
 #include <utilmoneystr.h>
 #include <validationinterface.h>
 
 #include <algorithm>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <utility>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // KusacoinMiner
@@ -440,6 +449,167 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+bool BlockAssembler::AppendNewTxs(std::unique_ptr<CBlockTemplate>& blocktemplate, const std::vector<uint256>& vHashes, int& nAppended)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    LOCK2(cs_main, mempool.cs);
+    const CBlockIndex* pindexPrev = chainActive.Tip();
+    assert(blocktemplate->block.hashPrevBlock == pindexPrev->GetBlockHash());
+
+    pblocktemplate = std::move(blocktemplate);
+    pblock = &pblocktemplate->block;
+
+    bool fComplete = true;
+    nAppended = 0;
+    for (const uint256& hash : vHashes) {
+        CTxMemPool::txiter iter = mempool.mapTx.find(hash);
+        // Gone again already
+        if (iter == mempool.mapTx.end() || inBlock.count(iter))
+            continue;
+
+        // Ancestor packages are left to a full rebuild
+        CTxMemPool::setEntries parents = mempool.GetMemPoolParents(iter);
+        onlyUnconfirmed(parents);
+        if (!parents.empty()) {
+            fComplete = false;
+            continue;
+        }
+
+        if (!iter->GetMemPoolOnly() &&
+            iter->GetModifiedFee() < blockMinFeeRate.GetFee(iter->GetTxSize())) {
+            continue;
+        }
+
+        if (!TestPackage(iter->GetTxSize(), iter->GetSigOpCost())) {
+            // A full rebuild may still make room for it at the expense of
+            // transactions with a lower feerate
+            fComplete = false;
+            continue;
+        }
+
+        CTxMemPool::setEntries package;
+        package.insert(iter);
+        if (!TestPackageTransactions(package))
+            continue;
+
+        AddToBlock(iter);
+        ++nAppended;
+    }
+
+    if (nAppended) {
+        nLastBlockTx = nBlockTx;
+        nLastBlockWeight = nBlockWeight;
+
+        CMutableTransaction coinbaseTx(*pblock->vtx[0]);
+        coinbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+        // Drop the witness commitment, it is generated again for the new transactions
+        coinbaseTx.vout.resize(1);
+        coinbaseTx.vin[0].scriptWitness.SetNull();
+        pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+        pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus());
+        pblocktemplate->vTxFees[0] = -nFees;
+    }
+
+    blocktemplate = std::move(pblocktemplate);
+    pblock = nullptr;
+
+    LogPrint(BCLog::BENCH, "AppendNewTxs(): %d of %u new txs appended, block weight: %u txs: %u fees: %ld (%.2fms)\n", nAppended, vHashes.size(), nBlockWeight, nBlockTx, nFees, 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return fComplete;
+}
+
+IncrementalBlockAssembler::IncrementalBlockAssembler(const CChainParams& params)
+    : chainparams(params), pindexPrev(nullptr), fMineWitnessTx(true), nSkippedSince(0), nFullBuilds(0),
+      nTransactionsUpdatedSeen(0), fStale(true)
+{
+    connAdded = mempool.NotifyEntryAdded.connect(boost::bind(&IncrementalBlockAssembler::TransactionAdded, this, _1));
+    connRemoved = mempool.NotifyEntryRemoved.connect(boost::bind(&IncrementalBlockAssembler::TransactionRemoved, this, _1, _2));
+}
+
+void IncrementalBlockAssembler::TransactionAdded(CTransactionRef tx)
+{
+    LOCK(cs);
+    ++nTransactionsUpdatedSeen;
+    if (!fStale)
+        vAdded.push_back(tx->GetHash());
+}
+
+void IncrementalBlockAssembler::TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    LOCK(cs);
+    ++nTransactionsUpdatedSeen;
+    // Transactions leaving for a block come with a new tip
+    if (reason == MemPoolRemovalReason::BLOCK || setTemplateTx.count(tx->GetHash())) {
+        fStale = true;
+        vAdded.clear();
+    }
+}
+
+CBlockTemplate* IncrementalBlockAssembler::GetBlockTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTxIn, int64_t nRebuildAfter)
+{
+    LOCK2(cs_main, mempool.cs);
+
+    bool fRebuild = !pblocktemplate || pindexPrev != chainActive.Tip() ||
+        scriptPubKey != scriptPubKeyIn || fMineWitnessTx != fMineWitnessTxIn;
+    std::vector<uint256> vHashes;
+    {
+        LOCK(cs);
+        // Any change to the mempool that was not an addition or a removal
+        // (e.g. a fee delta) invalidates the template as well
+        fRebuild |= fStale || nTransactionsUpdatedSeen != mempool.GetTransactionsUpdated();
+        vHashes.swap(vAdded);
+    }
+
+    if (!fRebuild && !vHashes.empty()) {
+        const size_t nPrevTx = pblocktemplate->block.vtx.size();
+        int nAppended;
+        if (!assembler->AppendNewTxs(pblocktemplate, vHashes, nAppended) && !nSkippedSince)
+            nSkippedSince = GetTime();
+        LOCK(cs);
+        for (size_t i = nPrevTx; i < pblocktemplate->block.vtx.size(); i++)
+            setTemplateTx.insert(pblocktemplate->block.vtx[i]->GetHash());
+    }
+    if (nSkippedSince && GetTime() - nSkippedSince >= nRebuildAfter)
+        fRebuild = true;
+
+    if (fRebuild) {
+        // Reset first so that a failure below leads to another attempt next time
+        pblocktemplate.reset();
+        assembler.reset(new BlockAssembler(chainparams));
+        pblocktemplate = assembler->CreateNewBlock(scriptPubKeyIn, fMineWitnessTxIn);
+        if (!pblocktemplate)
+            return nullptr;
+
+        pindexPrev = chainActive.Tip();
+        scriptPubKey = scriptPubKeyIn;
+        fMineWitnessTx = fMineWitnessTxIn;
+        nSkippedSince = 0;
+        ++nFullBuilds;
+
+        LOCK(cs);
+        setTemplateTx.clear();
+        for (size_t i = 1; i < pblocktemplate->block.vtx.size(); i++)
+            setTemplateTx.insert(pblocktemplate->block.vtx[i]->GetHash());
+        vAdded.clear();
+        nTransactionsUpdatedSeen = mempool.GetTransactionsUpdated();
+        fStale = false;
+    }
+
+    return pblocktemplate.get();
+}
+
+static void SetExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce)
+{
+    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -450,11 +620,193 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
-    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(*pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+    SetExtraNonce(pblock, pindexPrev, nExtraNonce);
+}
 
-    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+//////////////////////////////////////////////////////////////////////////////
+//
+// Internal miner
+//
+
+/** Nonces a miner thread tries between checks for a new tip or a stale template */
+static const uint32_t MINER_NONCE_BATCH = 0x1000;
+
+/** Serializes start/stop of the miner; never taken by the miner threads themselves */
+static std::mutex g_miner_control_mutex;
+static std::unique_ptr<boost::thread_group> g_miner_threads;
+
+static CCriticalSection cs_miner_stats;
+static std::vector<MinerThreadStats> g_miner_stats;
+
+static bool ProcessBlockFound(const std::shared_ptr<const CBlock>& pblock, const CChainParams& chainparams)
+{
+    LogPrintf("KusacoinMiner: new block found %s\n", pblock->GetHash().ToString());
+
+    {
+        LOCK(cs_main);
+        if (pblock->hashPrevBlock != chainActive.Tip()->GetBlockHash())
+            return error("KusacoinMiner: generated block is stale");
+    }
+
+    if (!ProcessNewBlock(chainparams, pblock, true, nullptr))
+        return error("KusacoinMiner: ProcessNewBlock, block not accepted");
+
+    // Another thread may have won the race for the same height
+    LOCK(cs_main);
+    BlockMap::const_iterator mi = mapBlockIndex.find(pblock->GetHash());
+    return mi != mapBlockIndex.end() && chainActive.Contains(mi->second);
+}
+
+static void KusacoinMiner(const CChainParams& chainparams, const CScript& coinbase_script, unsigned int nThread, unsigned int nThreads)
+{
+    LogPrintf("KusacoinMiner thread %u started\n", nThread);
+    RenameThread("kusacoin-miner");
+
+    // Every thread gets its own slice of the nonce space, and the extranonces
+    // nThread + k * nThreads, so no two threads ever hash the same header.
+    const uint32_t nNonceFirst = (uint32_t)(((uint64_t)nThread << 32) / nThreads);
+    const uint32_t nNonceLast = (uint32_t)((((uint64_t)nThread + 1) << 32) / nThreads - 1);
+    unsigned int nExtraNonce = nThread;
+
+    void* scratch = GetLyra2REv2ThreadScratch();
+    std::vector<unsigned char> header;
+    header.reserve(80);
+    uint256 hash;
+    int64_t nRateStart = GetTimeMicros();
+    uint64_t nRateHashes = 0;
+
+    try {
+        while (true) {
+            if (!chainparams.MineBlocksOnDemand()) {
+                // Mining without peers or during the initial block download would only produce stale blocks
+                while (!g_connman || g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || IsInitialBlockDownload())
+                    MilliSleep(1000);
+            }
+
+            unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+            std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(chainparams).CreateNewBlock(coinbase_script));
+            if (!pblocktemplate) {
+                LogPrintf("KusacoinMiner: couldn't create new block, stopping thread %u\n", nThread);
+                return;
+            }
+            CBlock* pblock = &pblocktemplate->block;
+            const CBlockIndex* pindexPrev;
+            {
+                LOCK(cs_main);
+                pindexPrev = chainActive.Tip();
+                if (pindexPrev->GetBlockHash() != pblock->hashPrevBlock)
+                    continue;
+                SetExtraNonce(pblock, pindexPrev, nExtraNonce);
+            }
+            nExtraNonce += nThreads;
+
+            const int64_t nStart = GetTime();
+            arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+            uint32_t nNonce = nNonceFirst;
+            while (true) {
+                // Serialize the header once; only the nonce is patched in for every try
+                CVectorWriter(SER_GETHASH, PROTOCOL_VERSION, header, 0) << pblock->GetBlockHeader();
+                const uint32_t nBatchFirst = nNonce;
+                const uint32_t nBatchLast = std::min<uint64_t>((uint64_t)nNonce + MINER_NONCE_BATCH - 1, nNonceLast);
+                bool fFound = false;
+                while (true) {
+                    WriteLE32(&header[76], nNonce);
+                    lyra2re2_hash_scratch((const char*)header.data(), (char*)hash.begin(), scratch);
+                    if (UintToArith256(hash) <= hashTarget) {
+                        fFound = true;
+                        break;
+                    }
+                    if (nNonce == nBatchLast)
+                        break;
+                    ++nNonce;
+                }
+
+                nRateHashes += (uint64_t)nNonce - nBatchFirst + 1;
+                const int64_t nNow = GetTimeMicros();
+                {
+                    LOCK(cs_miner_stats);
+                    if (nThread < g_miner_stats.size()) {
+                        MinerThreadStats& stats = g_miner_stats[nThread];
+                        stats.nHashes += (uint64_t)nNonce - nBatchFirst + 1;
+                        if (nNow - nRateStart >= 1000000) {
+                            stats.dHashesPerSec = nRateHashes * 1e6 / (nNow - nRateStart);
+                            nRateStart = nNow;
+                            nRateHashes = 0;
+                        }
+                    }
+                }
+
+                if (fFound) {
+                    pblock->nNonce = nNonce;
+                    if (ProcessBlockFound(std::make_shared<const CBlock>(*pblock), chainparams)) {
+                        LOCK(cs_miner_stats);
+                        if (nThread < g_miner_stats.size())
+                            g_miner_stats[nThread].nBlocks++;
+                    }
+                    break;
+                }
+
+                boost::this_thread::interruption_point();
+                // Move on to the next extranonce once this thread's slice is exhausted
+                if (nNonce == nNonceLast)
+                    break;
+                ++nNonce;
+                if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
+                    break;
+                {
+                    LOCK(cs_main);
+                    if (pindexPrev != chainActive.Tip())
+                        break;
+                }
+
+                // Recreate the block if the clock has run backwards, so that we can use the correct time
+                if (UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev) < 0)
+                    break;
+                if (chainparams.GetConsensus().fPowAllowMinDifficultyBlocks)
+                    hashTarget.SetCompact(pblock->nBits);
+            }
+        }
+    }
+    catch (const boost::thread_interrupted&)
+    {
+        LogPrintf("KusacoinMiner thread %u terminated\n", nThread);
+        throw;
+    }
+    catch (const std::runtime_error &e)
+    {
+        LogPrintf("KusacoinMiner thread %u runtime error: %s\n", nThread, e.what());
+        return;
+    }
+}
+
+void GenerateKusacoins(bool fGenerate, int nThreads, const CScript& coinbase_script, const CChainParams& chainparams)
+{
+    std::lock_guard<std::mutex> lock(g_miner_control_mutex);
+
+    if (nThreads < 0)
+        nThreads = GetNumCores();
+
+    if (g_miner_threads) {
+        g_miner_threads->interrupt_all();
+        g_miner_threads->join_all();
+        g_miner_threads.reset();
+    }
+
+    {
+        LOCK(cs_miner_stats);
+        g_miner_stats.assign(fGenerate ? nThreads : 0, MinerThreadStats());
+    }
+
+    if (!fGenerate || nThreads == 0)
+        return;
+
+    g_miner_threads.reset(new boost::thread_group());
+    for (int i = 0; i < nThreads; i++)
+        g_miner_threads->create_thread(std::bind(&KusacoinMiner, std::cref(chainparams), coinbase_script, i, nThreads));
+}
+
+std::vector<MinerThreadStats> GetMinerThreadStats()
+{
+    LOCK(cs_miner_stats);
+    return g_miner_stats;
 }
@@ -8,12 +8,16 @@
 #define KUSACOIN_MINER_H
 
 #include <primitives/block.h>
+#include <script/script.h>
+#include <sync.h>
 #include <txmempool.h>
 
 #include <stdint.h>
 #include <memory>
+#include <unordered_set>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/signals2/connection.hpp>
 
 class CBlockIndex;
 class CChainParams;
@@ -162,6 +166,13 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
 
+    /** Append transactions that entered the mempool after CreateNewBlock
+      * assembled blocktemplate on the current tip. A transaction is only
+      * taken if all its unconfirmed parents are in the template already and
+      * it fits; nAppended is set to the number taken. Returns false if any
+      * transaction a full rebuild might have taken had to be left out. */
+    bool AppendNewTxs(std::unique_ptr<CBlockTemplate>& blocktemplate, const std::vector<uint256>& vHashes, int& nAppended);
+
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
@@ -196,8 +207,72 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/**
+ * Keeps a block template on the current tip up to date with the mempool, for
+ * getblocktemplate. Transactions entering the mempool are appended to the
+ * template when it is requested next, so serving it again only costs the
+ * transactions that arrived in between. It is assembled from scratch when
+ * the tip changes, when one of its transactions leaves the mempool, when the
+ * mempool changed in another way (prioritisetransaction), or when
+ * transactions that could not be appended have waited for nRebuildAfter
+ * seconds.
+ */
+class IncrementalBlockAssembler
+{
+private:
+    const CChainParams& chainparams;
+
+    // State of the template, guarded by cs_main
+    std::unique_ptr<BlockAssembler> assembler;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    const CBlockIndex* pindexPrev;
+    CScript scriptPubKey;
+    bool fMineWitnessTx;
+    int64_t nSkippedSince;
+    uint64_t nFullBuilds;
+
+    // Mempool changes since the template was last updated
+    CCriticalSection cs;
+    std::unordered_set<uint256, SaltedTxidHasher> setTemplateTx;
+    std::vector<uint256> vAdded;
+    unsigned int nTransactionsUpdatedSeen;
+    bool fStale;
+
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+
+    void TransactionAdded(CTransactionRef tx);
+    void TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+
+public:
+    explicit IncrementalBlockAssembler(const CChainParams& params);
+
+    /** Return the template for the current tip with coinbase to scriptPubKeyIn */
+    CBlockTemplate* GetBlockTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTxIn, int64_t nRebuildAfter);
+
+    /** Number of times the template was assembled from scratch */
+    uint64_t GetFullBuilds() const { return nFullBuilds; }
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+/** Statistics of one thread of the internal miner */
+struct MinerThreadStats
+{
+    uint64_t nHashes = 0;
+    uint64_t nBlocks = 0;
+    double dHashesPerSec = 0;
+};
+
+/**
+ * Run the internal miner on nThreads threads (-1 for one per core), paying to
+ * coinbase_script, or stop it. Each thread searches its own slice of the nonce
+ * space and its own extranonces, and rebuilds its template on a new tip.
+ */
+void GenerateKusacoins(bool fGenerate, int nThreads, const CScript& coinbase_script, const CChainParams& chainparams);
+/** Per-thread statistics of the running internal miner; empty when it is stopped */
+std::vector<MinerThreadStats> GetMinerThreadStats();
+
 #endif // KUSACOIN_MINER_H
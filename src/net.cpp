@@ -26,6 +26,12 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 
 #ifdef USE_UPNP
@@ -74,6 +80,9 @@ enum BindFlags {
 
 const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
+/** Maximum number of send queue buffers written by one sendmsg() call, well below any IOV_MAX */
+static const size_t MAX_SEND_IOV = 64;
+
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
 //
@@ -712,6 +721,10 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_msgTime);
+        X(mapTimePerMsgCmd);
+    }
     X(fWhitelisted);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -886,27 +899,56 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
+        size_t nRequested = 0;
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            const auto &data = **it;
+            nRequested = data.size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nRequested, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Gather the queued buffers, headers and payloads alike, into one system call
+            struct iovec iov[MAX_SEND_IOV];
+            size_t nBuffers = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto itBuf = it; itBuf != pnode->vSendMsg.end() && nBuffers < MAX_SEND_IOV; ++itBuf) {
+                const auto &data = **itBuf;
+                iov[nBuffers].iov_base = const_cast<unsigned char*>(data.data()) + nOffset;
+                iov[nBuffers].iov_len = data.size() - nOffset;
+                nRequested += iov[nBuffers].iov_len;
+                nOffset = 0;
+                nBuffers++;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nBuffers;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Drop the buffers that went out completely
+            size_t nRemaining = nBytes;
+            while (nRemaining > 0) {
+                size_t nLeft = (*it)->size() - pnode->nSendOffset;
+                if (nRemaining < nLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    break;
+                }
+                nRemaining -= nLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= (*it)->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nRequested) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -929,6 +971,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
         assert(pnode->nSendSize == 0);
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    UpdateSocketInterest(pnode);
     return nSentSize;
 }
 
@@ -1105,7 +1148,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (socketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1141,6 +1184,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     pnode->AddRef();
     pnode->fWhitelisted = whitelisted;
     m_msgproc->InitializeNode(pnode);
+    UpdateSocketInterest(pnode);
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
@@ -1150,6 +1194,262 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode)
+{
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void CConnman::GenerateSocketInterest(std::vector<SocketInterest>& vInterest)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        vInterest.push_back({hListenSocket.socket, -1, true, false});
+    }
+
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes)
+    {
+        // Implement the following logic:
+        // * If there is data to send, wait for sending data. As this only
+        //   happens when optimistic write failed, we choose to first drain the
+        //   write buffer in this case before receiving more. This avoids
+        //   needlessly queueing received data, if the remote peer is not themselves
+        //   receiving data. This means properly utilizing TCP flow control signalling.
+        // * Otherwise, if there is space left in the receive buffer, wait for
+        //   receiving data.
+        // * Hand off all complete messages to the processor, to be handled without
+        //   blocking here.
+
+        bool select_recv = !pnode->fPauseRecv;
+        bool select_send;
+        {
+            LOCK(pnode->cs_vSend);
+            select_send = !pnode->vSendMsg.empty();
+        }
+
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+
+        vInterest.push_back({pnode->hSocket, pnode->GetId(), select_recv && !select_send, select_send});
+    }
+}
+
+void CConnman::SocketEventsSelect(const std::vector<SocketInterest>& vInterest, std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SOCKET_EVENTS_TIMEOUT * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    for (const SocketInterest& interest : vInterest) {
+        if (!IsSelectableSocket(interest.socket))
+            continue;
+        if (interest.id >= 0)
+            FD_SET(interest.socket, &fdsetError);
+        if (interest.recv)
+            FD_SET(interest.socket, &fdsetRecv);
+        if (interest.send)
+            FD_SET(interest.socket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, interest.socket);
+        have_fds = true;
+    }
+#ifdef USE_EPOLL
+    if (wakeupfd != -1) {
+        FD_SET(wakeupfd, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, (SOCKET)wakeupfd);
+        have_fds = true;
+    }
+#endif
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (const SocketInterest& interest : vInterest)
+                recv_set.insert(interest.socket);
+        }
+        interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        return;
+    }
+
+#ifdef USE_EPOLL
+    if (wakeupfd != -1 && FD_ISSET(wakeupfd, &fdsetRecv)) {
+        uint64_t nWakeups;
+        if (read(wakeupfd, &nWakeups, sizeof(nWakeups)) < 0) {}
+    }
+#endif
+    for (const SocketInterest& interest : vInterest) {
+        if (!IsSelectableSocket(interest.socket))
+            continue;
+        if (FD_ISSET(interest.socket, &fdsetRecv))
+            recv_set.insert(interest.socket);
+        if (FD_ISSET(interest.socket, &fdsetSend))
+            send_set.insert(interest.socket);
+        if (FD_ISSET(interest.socket, &fdsetError))
+            error_set.insert(interest.socket);
+    }
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // The registrations are kept up to date by UpdateSocketInterest, so there is
+    // nothing to walk here
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, SOCKET_EVENTS_TIMEOUT);
+    if (interruptNet)
+        return;
+
+    if (nEvents == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        if (events[i].data.fd == wakeupfd) {
+            uint64_t nWakeups;
+            if (read(wakeupfd, &nWakeups, sizeof(nWakeups)) < 0) {}
+            continue;
+        }
+        SOCKET hSocket = events[i].data.fd;
+        if (events[i].events & EPOLLIN)
+            recv_set.insert(hSocket);
+        if (events[i].events & EPOLLOUT)
+            send_set.insert(hSocket);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(hSocket);
+    }
+}
+#endif
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        SocketEventsEpoll(recv_set, send_set, error_set);
+        return;
+    }
+#endif
+    std::vector<SocketInterest> vInterest;
+    GenerateSocketInterest(vInterest);
+    SocketEventsSelect(vInterest, recv_set, send_set, error_set);
+}
+
+bool CConnman::InitSocketEvents()
+{
+#ifdef USE_EPOLL
+    // The wakeup descriptor lets other threads cut a wait for socket events short
+    wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupfd == -1) {
+        LogPrintf("eventfd failed: %s\n", NetworkErrorString(WSAGetLastError()));
+    }
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+        if (wakeupfd != -1) {
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = wakeupfd;
+            epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeupfd, &event);
+        }
+        // Listening sockets are bound before this and stay open until Stop
+        for (const ListenSocket& hListenSocket : vhListenSocket) {
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = hListenSocket.socket;
+            if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for socket %d: %s\n", hListenSocket.socket, NetworkErrorString(WSAGetLastError()));
+                return false;
+            }
+        }
+    }
+#endif
+    return true;
+}
+
+void CConnman::CloseSocketEvents()
+{
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+    if (wakeupfd != -1) {
+        close(wakeupfd);
+        wakeupfd = -1;
+    }
+#endif
+}
+
+void CConnman::WakeSocketHandler()
+{
+#ifdef USE_EPOLL
+    if (wakeupfd != -1) {
+        uint64_t nWakeup = 1;
+        if (write(wakeupfd, &nWakeup, sizeof(nWakeup)) < 0) {}
+    }
+#endif
+}
+
+void CConnman::UpdateSocketInterest(CNode* pnode) const
+{
+#ifdef USE_EPOLL
+    if (epollfd == -1)
+        return;
+
+    // Same logic as GenerateSocketInterest. Errors and hangups are always reported.
+    // cs_vSend is held throughout, so concurrent updates register the latest state.
+    LOCK(pnode->cs_vSend);
+    int events = !pnode->vSendMsg.empty() ? EPOLLOUT : pnode->fPauseRecv ? 0 : EPOLLIN;
+    if (events == pnode->nSocketEvents)
+        return;
+    LOCK(pnode->cs_hSocket);
+    // A closed socket was dropped from the epoll set when it was closed
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = pnode->hSocket;
+    if (epoll_ctl(epollfd, pnode->nSocketEvents == -1 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, pnode->hSocket, &event) != 0) {
+        LogPrintf("epoll_ctl failed for socket %d: %s\n", pnode->hSocket, NetworkErrorString(WSAGetLastError()));
+        return;
+    }
+    pnode->nSocketEvents = events;
+#endif
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1217,93 +1517,19 @@ void CConnman::ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Find which sockets have data to receive or can be sent to
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1334,9 +1560,9 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1363,12 +1589,16 @@ void CConnman::ThreadSocketHandler()
                                 break;
                             nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
                         }
+                        bool fPauseChanged;
                         {
                             LOCK(pnode->cs_vProcessMsg);
                             pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
                             pnode->nProcessQueueSize += nSizeAdded;
-                            pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+                            bool fPause = pnode->nProcessQueueSize > nReceiveFloodSize;
+                            fPauseChanged = pnode->fPauseRecv.exchange(fPause) != fPause;
                         }
+                        if (fPauseChanged)
+                            UpdateSocketInterest(pnode);
                         WakeMessageHandler();
                     }
                 }
@@ -1988,6 +2218,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+    UpdateSocketInterest(pnode);
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -2014,6 +2245,11 @@ void CConnman::ThreadMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            // Leave nodes that another message handler thread is busy with to it
+            TRY_LOCK(pnode->cs_msgProcessing, lockProcessing);
+            if (!lockProcessing)
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
@@ -2206,6 +2442,12 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nReceiveFloodSize = 0;
     flagInterruptMsgProc = false;
     SetTryNewOutboundPeer(false);
+    {
+        LOCK(cs_msgTime);
+        for (const std::string &msg : getAllNetMessageTypes())
+            mapTimePerMsgCmd[msg];
+        mapTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
+    }
 
     Options connOptions;
     Init(connOptions);
@@ -2335,6 +2577,9 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         fMsgProcWake = false;
     }
 
+    if (!InitSocketEvents())
+        return false;
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2358,7 +2603,8 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMsgHandlerThreads; i++)
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
@@ -2390,6 +2636,7 @@ void CConnman::Interrupt()
     condMsgProc.notify_all();
 
     interruptNet();
+    WakeSocketHandler();
     InterruptSocks5(true);
 
     if (semOutbound) {
@@ -2407,8 +2654,10 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& threadMessageHandler : threadMessageHandlers)
+        if (threadMessageHandler.joinable())
+            threadMessageHandler.join();
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2444,6 +2693,8 @@ void CConnman::Stop()
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
+
+    CloseSocketEvents();
 }
 
 void CConnman::DeleteNode(CNode* pnode)
@@ -2565,6 +2816,46 @@ void CConnman::RecordBytesRecv(uint64_t bytes)
     nTotalBytesRecv += bytes;
 }
 
+void CTimeHistogram::Add(int64_t nMicros)
+{
+    nMicros = std::max(nMicros, (int64_t)0);
+    int nBucket = 0;
+    while (nBucket < NUM_BUCKETS - 1 && (nMicros >> nBucket) != 0)
+        nBucket++;
+    vBuckets[nBucket]++;
+    nCount++;
+    nTotalMicros += nMicros;
+    nMaxMicros = std::max(nMaxMicros, nMicros);
+}
+
+static void AddMessageTime(mapMsgCmdTime& mapTime, const std::string& command, int64_t nQueueMicros, int64_t nProcessMicros)
+{
+    // Unknown commands are counted together, as for the received bytes
+    mapMsgCmdTime::iterator it = mapTime.find(command);
+    if (it == mapTime.end())
+        it = mapTime.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(it != mapTime.end());
+    if (nQueueMicros >= 0)
+        it->second.queue.Add(nQueueMicros);
+    it->second.process.Add(nProcessMicros);
+}
+
+void CConnman::RecordMessageTime(CNode* pnode, const std::string& command, int64_t nQueueMicros, int64_t nProcessMicros)
+{
+    {
+        LOCK(pnode->cs_msgTime);
+        AddMessageTime(pnode->mapTimePerMsgCmd, command, nQueueMicros, nProcessMicros);
+    }
+    LOCK(cs_msgTime);
+    AddMessageTime(mapTimePerMsgCmd, command, nQueueMicros, nProcessMicros);
+}
+
+void CConnman::GetMessageTimeStats(mapMsgCmdTime& stats)
+{
+    LOCK(cs_msgTime);
+    stats = mapTimePerMsgCmd;
+}
+
 void CConnman::RecordBytesSent(uint64_t bytes)
 {
     LOCK(cs_totalBytesSent);
@@ -2744,10 +3035,17 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fPauseRecv = false;
     fPauseSend = false;
     nProcessQueueSize = 0;
+    nSocketEvents = -1;
 
     for (const std::string &msg : getAllNetMessageTypes())
         mapRecvBytesPerMsgCmd[msg] = 0;
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    {
+        LOCK(cs_msgTime);
+        for (const std::string &msg : getAllNetMessageTypes())
+            mapTimePerMsgCmd[msg];
+        mapTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
+    }
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", addrName, id);
@@ -2800,12 +3098,9 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+CSharedNetMsg MakeSharedNetMsg(CSerializedNetMsg&& msg)
 {
     size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
-
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
     uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
@@ -2814,7 +3109,26 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
+    CSharedNetMsg shared;
+    shared.header = std::make_shared<const std::vector<unsigned char>>(std::move(serializedHeader));
+    shared.data = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
+    shared.command = std::move(msg.command);
+    return shared;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    PushMessage(pnode, MakeSharedNetMsg(std::move(msg)));
+}
+
+void CConnman::PushMessage(CNode* pnode, const CSharedNetMsg& msg)
+{
+    size_t nMessageSize = msg.data->size();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
+
     size_t nBytesSent = 0;
+    bool fWakeSocketHandler = false;
     {
         LOCK(pnode->cs_vSend);
         bool optimisticSend(pnode->vSendMsg.empty());
@@ -2825,16 +3139,23 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        pnode->vSendMsg.push_back(msg.header);
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(msg.data);
 
         // If write queue empty, attempt "optimistic write"
-        if (optimisticSend == true)
+        if (optimisticSend == true) {
             nBytesSent = SocketSendData(pnode);
+            // The socket did not take it all, have the socket thread wait until it can send more.
+            // In epoll mode SocketSendData already registered the socket for that.
+            if (!pnode->vSendMsg.empty() && socketEventsMode == SOCKETEVENTS_SELECT)
+                fWakeSocketHandler = true;
+        }
     }
     if (nBytesSent)
         RecordBytesSent(nBytesSent);
+    if (fWakeSocketHandler)
+        WakeSocketHandler();
 }
 
 bool CConnman::ForNode(NodeId id, std::function<bool(CNode* pnode)> func)
@@ -23,6 +23,7 @@
 #include <uint256.h>
 #include <threadinterrupt.h>
 
+#include <array>
 #include <atomic>
 #include <deque>
 #include <stdint.h>
@@ -85,6 +86,29 @@ static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
+/** Default number of threads processing peer messages */
+static const int DEFAULT_MSG_HANDLER_THREADS = 4;
+/** Maximum number of threads processing peer messages */
+static const int MAX_MSG_HANDLER_THREADS = 16;
+
+/** How the socket thread waits for its sockets to become ready */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT,
+    SOCKETEVENTS_EPOLL,
+};
+/** Default for -socketevents */
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_EPOLL;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_SELECT;
+#endif
+/** Parse a -socketevents mode, returns false if it is unknown or not available in this build */
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode);
+/** Milliseconds the socket thread waits for events before polling the send queues again */
+static const int SOCKET_EVENTS_TIMEOUT = 50;
+/** Maximum number of events taken from epoll in one wait */
+static const int MAX_EPOLL_EVENTS = 1024;
+
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
@@ -114,6 +138,47 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * A serialized message with its header already built. The buffers are
+ * immutable and shared, so the same message can be queued to any number of
+ * peers without serializing, hashing or copying it again.
+ */
+struct CSharedNetMsg
+{
+    std::shared_ptr<const std::vector<unsigned char>> header;
+    std::shared_ptr<const std::vector<unsigned char>> data;
+    std::string command;
+};
+
+/** Build the header of a serialized message and move it into shared buffers */
+CSharedNetMsg MakeSharedNetMsg(CSerializedNetMsg&& msg);
+
+/**
+ * Histogram of durations. Bucket i counts the durations shorter than 2^i
+ * microseconds that do not fall in a lower bucket, the last bucket counts
+ * everything longer.
+ */
+class CTimeHistogram
+{
+public:
+    static const int NUM_BUCKETS = 24;
+
+    uint64_t nCount = 0;
+    int64_t nTotalMicros = 0;
+    int64_t nMaxMicros = 0;
+    std::array<uint64_t, NUM_BUCKETS> vBuckets{};
+
+    void Add(int64_t nMicros);
+};
+
+/** Time messages of one command waited in the process queue, and took to process */
+struct CMsgTimeStats
+{
+    CTimeHistogram queue;
+    CTimeHistogram process;
+};
+typedef std::map<std::string, CMsgTimeStats> mapMsgCmdTime; //command, time statistics
+
 class NetEventsInterface;
 class CConnman
 {
@@ -146,6 +211,8 @@ public:
         bool m_use_addrman_outgoing = true;
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
+        SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
+        int nMsgHandlerThreads = DEFAULT_MSG_HANDLER_THREADS;
     };
 
     void Init(const Options& connOptions) {
@@ -159,6 +226,8 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        socketEventsMode = connOptions.socketEventsMode;
+        nMsgHandlerThreads = std::max(1, std::min(connOptions.nMsgHandlerThreads, MAX_MSG_HANDLER_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -184,6 +253,7 @@ public:
     bool ForNode(NodeId id, std::function<bool(CNode* pnode)> func);
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
+    void PushMessage(CNode* pnode, const CSharedNetMsg& msg);
 
     template<typename Callable>
     void ForEachNode(Callable&& func)
@@ -306,6 +376,15 @@ public:
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    /**
+     * Account a message of pnode that waited nQueueMicros in the process
+     * queue and took nProcessMicros to process. A negative nQueueMicros
+     * only accounts processing time, for work a message left behind.
+     */
+    void RecordMessageTime(CNode* pnode, const std::string& command, int64_t nQueueMicros, int64_t nProcessMicros);
+    //! Message time statistics of all peers since startup
+    void GetMessageTimeStats(mapMsgCmdTime& stats);
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -315,6 +394,13 @@ public:
     unsigned int GetReceiveFloodSize() const;
 
     void WakeMessageHandler();
+    /** Make the socket thread look at the sockets again without waiting out its timeout */
+    void WakeSocketHandler();
+    /**
+     * Bring the events a node's socket is waited on for in line with its send queue
+     * and fPauseRecv. Must be called after either changes; a no-op unless in epoll mode.
+     */
+    void UpdateSocketInterest(CNode* pnode) const;
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -332,6 +418,29 @@ private:
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+
+    /** A socket the socket thread waits on, and for what */
+    struct SocketInterest {
+        SOCKET socket;
+        //! Node the socket belongs to, -1 for listening sockets
+        NodeId id;
+        bool recv;
+        bool send;
+    };
+    /**
+     * Find which sockets to wait on for receiving and sending. Node sockets are also waited on for errors.
+     * Only select mode needs this every time; epoll registrations are updated as nodes change.
+     */
+    void GenerateSocketInterest(std::vector<SocketInterest>& vInterest);
+    /** Create the descriptors the socket events mode needs */
+    bool InitSocketEvents();
+    void CloseSocketEvents();
+    /** Wait until sockets are ready or the timeout passes, and fill the sets with the ready sockets */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(const std::vector<SocketInterest>& vInterest, std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -373,6 +482,8 @@ private:
     CCriticalSection cs_totalBytesSent;
     uint64_t nTotalBytesRecv GUARDED_BY(cs_totalBytesRecv);
     uint64_t nTotalBytesSent GUARDED_BY(cs_totalBytesSent);
+    CCriticalSection cs_msgTime;
+    mapMsgCmdTime mapTimePerMsgCmd GUARDED_BY(cs_msgTime);
 
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle GUARDED_BY(cs_totalBytesSent);
@@ -425,14 +536,22 @@ private:
     std::condition_variable condMsgProc;
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
+    int nMsgHandlerThreads;
 
     CThreadInterrupt interruptNet;
 
+    SocketEventsMode socketEventsMode;
+#ifdef USE_EPOLL
+    int epollfd = -1;
+    //! eventfd that wakes the socket thread, -1 if not available
+    int wakeupfd = -1;
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -539,6 +658,7 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdTime mapTimePerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -609,9 +729,11 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<std::shared_ptr<const std::vector<unsigned char>>> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
+    //! Events hSocket is registered for with epoll, -1 if it is not registered. Guarded by cs_vSend.
+    int nSocketEvents;
     CCriticalSection cs_vRecv;
 
     CCriticalSection cs_vProcessMsg;
@@ -619,6 +741,9 @@ public:
     size_t nProcessQueueSize;
 
     CCriticalSection cs_sendProcessing;
+    // Held by the message handler thread that is processing this node, so
+    // each node's messages are handled by one thread at a time and in order
+    CCriticalSection cs_msgProcessing;
 
     std::deque<CInv> vRecvGetData;
     uint64_t nRecvBytes;
@@ -665,12 +790,17 @@ protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    CCriticalSection cs_msgTime;
+    mapMsgCmdTime mapTimePerMsgCmd GUARDED_BY(cs_msgTime);
 
 public:
     uint256 hashContinue;
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    // vAddrToSend and addrKnown are also filled by message handler threads
+    // relaying addresses from other nodes, so they are protected by cs_addrSend
+    CCriticalSection cs_addrSend;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -793,6 +923,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -801,6 +932,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
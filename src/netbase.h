@@ -20,6 +20,8 @@
 
 extern int nConnectTimeout;
 extern bool fNameLookup;
+//! Reject sockets select() cannot wait on, unless the node waits for socket events another way
+extern bool fRequireSelectableSockets;
 
 //! -timeout default
 static const int DEFAULT_CONNECT_TIMEOUT = 5000;
@@ -15,6 +15,54 @@ uint256 CBlockHeader::GetHash() const
     return SerializeHashLyra2LEv2(*this);
 }
 
+static bool SameHeader(const CBlockHeader& a, const CBlockHeader& b)
+{
+    return a.nVersion == b.nVersion && a.hashPrevBlock == b.hashPrevBlock &&
+           a.hashMerkleRoot == b.hashMerkleRoot && a.nTime == b.nTime &&
+           a.nBits == b.nBits && a.nNonce == b.nNonce;
+}
+
+CBlockHeaderHashCache::CBlockHeaderHashCache(const CBlockHeaderHashCache& other)
+{
+    *this = other;
+}
+
+CBlockHeaderHashCache& CBlockHeaderHashCache::operator=(const CBlockHeaderHashCache& other)
+{
+    if (this != &other) {
+        CBlockHeader other_header;
+        uint256 other_hash;
+        bool other_valid;
+        {
+            std::lock_guard<std::mutex> lock(other.mutex);
+            other_header = other.header;
+            other_hash = other.hash;
+            other_valid = other.fValid;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        header = other_header;
+        hash = other_hash;
+        fValid = other_valid;
+    }
+    return *this;
+}
+
+uint256 CBlockHeaderHashCache::GetHash(const CBlockHeader& current)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fValid && SameHeader(header, current))
+            return hash;
+    }
+    // Hash outside the lock; concurrent callers at worst hash the same header twice
+    uint256 result = current.GetHash();
+    std::lock_guard<std::mutex> lock(mutex);
+    header = current;
+    hash = result;
+    fValid = true;
+    return result;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
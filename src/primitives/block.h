@@ -11,6 +11,8 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <mutex>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -70,6 +72,28 @@ public:
 };
 
 
+/**
+ * Memory-only memo of the hash of a block header. It remembers which header
+ * it was computed for, so it cannot go stale when the header is modified;
+ * comparing 80 bytes is much cheaper than Lyra2REv2. Copies carry the memo.
+ */
+class CBlockHeaderHashCache
+{
+private:
+    mutable std::mutex mutex;
+    CBlockHeader header;
+    uint256 hash;
+    bool fValid = false;
+
+public:
+    CBlockHeaderHashCache() = default;
+    CBlockHeaderHashCache(const CBlockHeaderHashCache& other);
+    CBlockHeaderHashCache& operator=(const CBlockHeaderHashCache& other);
+
+    //! Return the memoized hash of header, or compute and memoize it
+    uint256 GetHash(const CBlockHeader& header);
+};
+
 class CBlock : public CBlockHeader
 {
 public:
@@ -78,6 +102,7 @@ public:
 
     // memory only
     mutable bool fChecked;
+    mutable CBlockHeaderHashCache hashCache;
 
     CBlock()
     {
@@ -117,6 +142,12 @@ public:
         return block;
     }
 
+    //! Like CBlockHeader::GetHash(), but only rehashes after the header changed
+    uint256 GetHash() const
+    {
+        return hashCache.GetHash(*this);
+    }
+
     std::string ToString() const;
 };
 
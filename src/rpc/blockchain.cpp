@@ -14,6 +14,7 @@
 #include <consensus/validation.h>
 #include <validation.h>
 #include <core_io.h>
+#include <crypto/muhash.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
@@ -26,6 +27,9 @@
 #include <utilstrencodings.h>
 #include <hash.h>
 #include <validationinterface.h>
+#ifdef ENABLE_WALLET
+#include <wallet/wallet.h>
+#endif
 #include <warnings.h>
 
 #include <stdint.h>
@@ -34,9 +38,11 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 struct CUpdatedBlock
 {
@@ -825,6 +831,26 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
+//! The hashes of the UTXO set that gettxoutsetinfo can calculate
+enum class CoinStatsHashType {
+    HASH_SERIALIZED, //!< hash_serialized_2, which depends on the order of the coins
+    MUHASH,          //!< MuHash3072 of the coins, which does not
+    NONE,
+};
+
+//! Maximum number of threads scanning the UTXO set, when the order does not matter
+static const int MAX_UTXO_STATS_THREADS = 8;
+//! Number of key ranges per thread, so that threads done early can take over some of the work
+static const int UTXO_STATS_SHARDS_PER_THREAD = 4;
+
+static void ApplyOutputStats(CCoinsStats &stats, const Coin& coin)
+{
+    stats.nTransactionOutputs++;
+    stats.nTotalAmount += coin.out.nValue;
+    stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                       2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
 static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
     assert(!outputs.empty());
@@ -835,10 +861,7 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT(output.first + 1);
         ss << output.second.out.scriptPubKey;
         ss << VARINT(output.second.out.nValue);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        ApplyOutputStats(stats, output.second);
     }
     ss << VARINT(0);
 }
@@ -882,6 +905,101 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
     return true;
 }
 
+//! Scan the coins from the cursor on, up to the txid hashEnd (or to the end if it is null)
+static bool ScanUTXOShard(CCoinsViewCursor *pcursor, const uint256& hashEnd, CCoinsStats &stats, MuHash3072* muhash)
+{
+    bool fFirst = true;
+    uint256 prevkey;
+    while (pcursor->Valid()) {
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            return false;
+        }
+        if (!hashEnd.IsNull() && !(key.hash < hashEnd)) {
+            break;
+        }
+        // All outputs of a transaction are next to each other, and in the same shard
+        if (fFirst || key.hash != prevkey) {
+            stats.nTransactions++;
+            prevkey = key.hash;
+            fFirst = false;
+        }
+        ApplyOutputStats(stats, coin);
+        if (muhash) {
+            CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+            ss << key << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase) << coin.out;
+            *muhash *= MuHash3072((const unsigned char*)ss.data(), ss.size());
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+//! Calculate statistics about the unspent transaction output set, splitting it into txid ranges that are scanned on several threads
+static bool GetUTXOStatsParallel(CCoinsViewDB *view, CCoinsStats &stats, CoinStatsHashType hash_type)
+{
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_UTXO_STATS_THREADS));
+    const int nShards = nThreads * UTXO_STATS_SHARDS_PER_THREAD;
+    std::vector<uint256> vStarts(nShards);
+    std::vector<std::unique_ptr<CCoinsViewCursor>> vCursors;
+    {
+        // The database is only written to while holding cs_main, so all
+        // cursors see the same state.
+        LOCK(cs_main);
+        for (int i = 0; i < nShards; i++) {
+            *vStarts[i].begin() = i * 256 / nShards;
+            vCursors.emplace_back(view->Cursor(vStarts[i]));
+        }
+        stats.hashBlock = vCursors[0]->GetBestBlock();
+        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+    }
+
+    std::vector<CCoinsStats> vStats(nShards);
+    std::vector<MuHash3072> vMuHash(nShards);
+    std::atomic<int> nNextShard(0);
+    std::atomic<bool> fOk(true);
+    auto scan = [&]() {
+        try {
+            int i;
+            while (fOk && (i = nNextShard++) < nShards) {
+                const uint256 hashEnd = i + 1 < nShards ? vStarts[i + 1] : uint256();
+                if (!ScanUTXOShard(vCursors[i].get(), hashEnd, vStats[i], hash_type == CoinStatsHashType::MUHASH ? &vMuHash[i] : nullptr)) {
+                    fOk = false;
+                }
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            fOk = false;
+        }
+    };
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < nThreads; i++) {
+        vThreads.emplace_back(scan);
+    }
+    scan();
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+    if (!fOk) {
+        return error("%s: unable to read value", __func__);
+    }
+
+    MuHash3072 muhash;
+    for (int i = 0; i < nShards; i++) {
+        stats.nTransactions += vStats[i].nTransactions;
+        stats.nTransactionOutputs += vStats[i].nTransactionOutputs;
+        stats.nBogoSize += vStats[i].nBogoSize;
+        stats.nTotalAmount += vStats[i].nTotalAmount;
+        muhash *= vMuHash[i];
+    }
+    if (hash_type == CoinStatsHashType::MUHASH) {
+        muhash.Finalize(stats.hashSerialized.begin());
+    }
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
+
 UniValue pruneblockchain(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -933,11 +1051,16 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
             "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"   (string, optional, default=hash_serialized_2) Which UTXO set hash to calculate.\n"
+            "                  Options: 'hash_serialized_2' (legacy, scans the set on one thread),\n"
+            "                  'muhash' (does not depend on the order of the coins, scans the set on several threads),\n"
+            "                  'none' (scans the set on several threads)\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -945,26 +1068,45 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
             "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only with hash_type 'hash_serialized_2')\n"
+            "  \"muhash\": \"hash\",    (string) The MuHash3072 of the coins (only with hash_type 'muhash')\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "muhash")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED;
+    if (!request.params[0].isNull()) {
+        const std::string strHashType = request.params[0].get_str();
+        if (strHashType == "muhash") {
+            hash_type = CoinStatsHashType::MUHASH;
+        } else if (strHashType == "none") {
+            hash_type = CoinStatsHashType::NONE;
+        } else if (strHashType != "hash_serialized_2") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type: " + strHashType);
+        }
+    }
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
     FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
+    bool fOk = hash_type == CoinStatsHashType::HASH_SERIALIZED ? GetUTXOStats(pcoinsdbview.get(), stats) : GetUTXOStatsParallel(pcoinsdbview.get(), stats, hash_type);
+    if (fOk) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
         ret.push_back(Pair("bogosize", (int64_t)stats.nBogoSize));
-        ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+        } else if (hash_type == CoinStatsHashType::MUHASH) {
+            ret.push_back(Pair("muhash", stats.hashSerialized.GetHex()));
+        }
         ret.push_back(Pair("disk_size", stats.nDiskSize));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     } else {
@@ -1587,6 +1729,231 @@ UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue UTXOSnapshotToJSON(const UTXOSnapshotInfo& info, const fs::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins", (int64_t)info.nCoins));
+    ret.push_back(Pair("base_hash", info.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", info.nHeight));
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("checksum", info.hashFile.GetHex()));
+    return ret;
+}
+
+static const std::string UTXO_SNAPSHOT_RESULT_HELP =
+    "{\n"
+    "  \"coins\": n,               (numeric) The number of coins in the snapshot\n"
+    "  \"base_hash\": \"hex\",       (string) The block after which the coins are the UTXO set\n"
+    "  \"base_height\": n,         (numeric) The height of that block\n"
+    "  \"path\": \"path\",           (string) The absolute path of the snapshot file\n"
+    "  \"checksum\": \"hex\"         (string) The hash of the file contents\n"
+    "}\n";
+
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the UTXO set after the current tip to a snapshot file, which loadtxoutset\n"
+            "can load on another node.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative to the data directory. It must not exist yet.\n"
+            "\nResult:\n"
+            + UTXO_SNAPSHOT_RESULT_HELP +
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    UTXOSnapshotInfo info;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, info, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+    return UTXOSnapshotToJSON(info, path);
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nReplaces the UTXO set with the one in a snapshot file written by dumptxoutset, and\n"
+            "continues the chain from the block of the snapshot. That block and its ancestors\n"
+            "must have been received, and the current tip must be one of them: headers alone\n"
+            "are not enough.\n"
+            "Only snapshots whose block and file hash are built into the chain parameters, or\n"
+            "given with -assumeutxo on regtest, are accepted. The blocks up to the snapshot are\n"
+            "marked assumed valid instead of being validated. The chain cannot be reorganized\n"
+            "to below the block of the snapshot, and the mempool is cleared.\n"
+            "Wallets would miss the transactions of the skipped blocks, so no wallet may be loaded.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The snapshot file, relative to the data directory\n"
+            "\nResult:\n"
+            + UTXO_SNAPSHOT_RESULT_HELP +
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+    }
+
+#ifdef ENABLE_WALLET
+    if (!vpwallets.empty()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "A UTXO snapshot cannot be loaded while wallets are loaded, restart with -disablewallet");
+    }
+#endif
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    UTXOSnapshotInfo info;
+    std::string strError;
+    if (!LoadUTXOSnapshot(Params(), path, info, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    // Connect the blocks received after the one of the snapshot
+    CValidationState state;
+    ActivateBestChain(state, Params());
+    if (!state.IsValid()) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
+    }
+    return UTXOSnapshotToJSON(info, path);
+}
+
+static CDBWrapper& GetDBByName(const std::string& name)
+{
+    LOCK(cs_main);
+    if (name == "chainstate") {
+        return pcoinsdbview->GetDB();
+    }
+    if (name == "blockindex") {
+        return *pblocktree;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown database: " + name);
+}
+
+static UniValue DBInfoToJSON(const CDBWrapper& db)
+{
+    const CDBOptions& db_options = db.GetDBOptions();
+    UniValue options(UniValue::VOBJ);
+    options.push_back(Pair("cache_size", (uint64_t)db_options.nCacheSize));
+    options.push_back(Pair("write_buffer_size", (uint64_t)(db_options.nWriteBufferSize ? db_options.nWriteBufferSize : db_options.nCacheSize / 4)));
+    options.push_back(Pair("block_size", (uint64_t)db_options.nBlockSize));
+    options.push_back(Pair("max_file_size", (uint64_t)db_options.nMaxFileSize));
+    options.push_back(Pair("max_open_files", db_options.nMaxOpenFiles));
+    options.push_back(Pair("bloom_bits_per_key", db_options.nBloomBitsPerKey));
+
+    UniValue levels(UniValue::VARR);
+    for (const CDBLevelStats& stats : db.GetLevelStats()) {
+        UniValue level(UniValue::VOBJ);
+        level.push_back(Pair("level", stats.nLevel));
+        level.push_back(Pair("files", stats.nFiles));
+        level.push_back(Pair("size_mib", stats.dSizeMiB));
+        level.push_back(Pair("compaction_seconds", stats.dCompactionSeconds));
+        level.push_back(Pair("read_mib", stats.dReadMiB));
+        level.push_back(Pair("written_mib", stats.dWrittenMiB));
+        levels.push_back(level);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("options", options));
+    ret.push_back(Pair("estimated_size", (uint64_t)db.EstimateRawSize("", "")));
+    ret.push_back(Pair("approximate_memory_usage", (uint64_t)db.GetMemoryUsage()));
+    ret.push_back(Pair("levels", levels));
+    return ret;
+}
+
+UniValue getdbinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getdbinfo\n"
+            "\nReturns the LevelDB options and statistics of the chainstate and blockindex databases.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"chainstate\": {\n"
+            "    \"options\": {                  (object) The options the database was opened with\n"
+            "      \"cache_size\": n,            (numeric) Memory for the block cache and the write buffers in bytes\n"
+            "      \"write_buffer_size\": n,     (numeric) Size of a write buffer in bytes\n"
+            "      \"block_size\": n,            (numeric) Size of the table blocks in bytes\n"
+            "      \"max_file_size\": n,         (numeric) Size of the table files in bytes\n"
+            "      \"max_open_files\": n,        (numeric) Number of files kept open\n"
+            "      \"bloom_bits_per_key\": n     (numeric) Bits per key of the bloom filters\n"
+            "    },\n"
+            "    \"estimated_size\": n,          (numeric) Estimated size on disk in bytes\n"
+            "    \"approximate_memory_usage\": n,(numeric) Memory used by the memtables and the block cache in bytes\n"
+            "    \"levels\": [                   (array) The levels that have files or were compacted\n"
+            "      {\n"
+            "        \"level\": n,               (numeric) The level\n"
+            "        \"files\": n,               (numeric) The number of table files\n"
+            "        \"size_mib\": n,            (numeric) Their size in MiB\n"
+            "        \"compaction_seconds\": n,  (numeric) Time spent compacting into this level\n"
+            "        \"read_mib\": n,            (numeric) Data read by those compactions in MiB\n"
+            "        \"written_mib\": n          (numeric) Data written by those compactions in MiB\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  },\n"
+            "  \"blockindex\": { ... }          (object) The same for the block index database\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbinfo", "")
+            + HelpExampleRpc("getdbinfo", "")
+        );
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    for (const std::string name : {"chainstate", "blockindex"}) {
+        ret.push_back(Pair(name, DBInfoToJSON(GetDBByName(name))));
+    }
+    return ret;
+}
+
+UniValue compactdb(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3) {
+        throw std::runtime_error(
+            "compactdb \"db\" ( \"begin\" \"end\" )\n"
+            "\nCompacts a range of keys of a database, and waits until the compaction is done.\n"
+            "\nArguments:\n"
+            "1. \"db\"      (string, required) \"chainstate\" or \"blockindex\"\n"
+            "2. \"begin\"   (string, optional) The first serialized key in hex, e.g. \"43\" for the coins (default: the first key)\n"
+            "3. \"end\"     (string, optional) The last serialized key in hex (default: the last key)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size_before\": n,  (numeric) Estimated size of the range on disk before the compaction in bytes\n"
+            "  \"size_after\": n,   (numeric) Estimated size after the compaction in bytes\n"
+            "  \"seconds\": n       (numeric) Time the compaction took\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("compactdb", "\"chainstate\"")
+            + HelpExampleCli("compactdb", "\"chainstate\" \"43\" \"44\"")
+            + HelpExampleRpc("compactdb", "\"blockindex\"")
+        );
+    }
+
+    CDBWrapper& db = GetDBByName(request.params[0].get_str());
+    std::string range[2];
+    for (int i = 0; i < 2; i++) {
+        if (request.params.size() > (size_t)i + 1) {
+            const std::string& hex = request.params[i + 1].get_str();
+            if (!IsHex(hex) && !hex.empty()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Keys must be hex strings");
+            }
+            std::vector<unsigned char> key = ParseHex(hex);
+            range[i].assign(key.begin(), key.end());
+        }
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("size_before", (uint64_t)db.EstimateRawSize(range[0], range[1])));
+    int64_t nStart = GetTimeMicros();
+    db.CompactRawRange(range[0], range[1]);
+    ret.push_back(Pair("seconds", (GetTimeMicros() - nStart) * 0.000001));
+    ret.push_back(Pair("size_after", (uint64_t)db.EstimateRawSize(range[0], range[1])));
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1605,7 +1972,11 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
+    { "blockchain",         "getdbinfo",              &getdbinfo,              {} },
+    { "blockchain",         "compactdb",              &compactdb,              {"db","begin","end"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -127,7 +127,8 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
+        // Every try changes the header, so bypass CBlock's hash cache
+        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->CBlockHeader::GetHash(), pblock->nBits, Params().GetConsensus())) {
             ++pblock->nNonce;
             --nMaxTries;
         }
@@ -186,6 +187,100 @@ UniValue generatetoaddress(const JSONRPCRequest& request)
     return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false);
 }
 
+UniValue setgenerate(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "setgenerate generate ( genproclimit \"address\" )\n"
+            "\nTurn the internal miner on or off. It mines in the background on 'genproclimit'\n"
+            "threads, and keeps building on the current tip until it is turned off.\n"
+            "\nArguments:\n"
+            "1. generate         (boolean, required) Set to true to turn on generation, false to turn off.\n"
+            "2. genproclimit     (numeric, optional, default=1) The number of mining threads, -1 for one per core.\n"
+            "3. address          (string, required if generate is true) The address to send the newly generated kusacoin to.\n"
+            "\nExamples:\n"
+            "\nMine on 4 threads to myaddress\n"
+            + HelpExampleCli("setgenerate", "true 4 \"myaddress\"") +
+            "\nTurn off generation\n"
+            + HelpExampleCli("setgenerate", "false") +
+            "\nUsing json rpc\n"
+            + HelpExampleRpc("setgenerate", "true, 4, \"myaddress\"")
+        );
+
+    bool fGenerate = request.params[0].get_bool();
+    int nGenProcLimit = 1;
+    if (!request.params[1].isNull()) {
+        nGenProcLimit = request.params[1].get_int();
+        if (nGenProcLimit == 0)
+            fGenerate = false;
+    }
+
+    CScript coinbase_script;
+    if (fGenerate) {
+        if (request.params[2].isNull())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Error: An address is required to generate to");
+        CTxDestination destination = DecodeDestination(request.params[2].get_str());
+        if (!IsValidDestination(destination)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Error: Invalid address");
+        }
+        coinbase_script = GetScriptForDestination(destination);
+    }
+
+    GenerateKusacoins(fGenerate, nGenProcLimit, coinbase_script, Params());
+    return NullUniValue;
+}
+
+UniValue getminerinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getminerinfo\n"
+            "\nReturns the state of the internal miner, see setgenerate.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"generate\": true|false,     (boolean) Whether the internal miner is running\n"
+            "  \"hashespersec\": x,          (numeric) The hashes per second of all threads together\n"
+            "  \"hashes\": n,                (numeric) The number of hashes tried since the miner was started\n"
+            "  \"blocks\": n,                (numeric) The number of blocks found since the miner was started\n"
+            "  \"threads\": [                (array) Per-thread statistics\n"
+            "    {\n"
+            "      \"hashespersec\": x,      (numeric) The hashes per second of this thread\n"
+            "      \"hashes\": n,            (numeric) The number of hashes tried by this thread\n"
+            "      \"blocks\": n             (numeric) The number of blocks found by this thread\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getminerinfo", "")
+            + HelpExampleRpc("getminerinfo", "")
+        );
+
+    std::vector<MinerThreadStats> stats = GetMinerThreadStats();
+    double dHashesPerSec = 0;
+    uint64_t nHashes = 0;
+    uint64_t nBlocks = 0;
+    UniValue threads(UniValue::VARR);
+    for (const MinerThreadStats& thread_stats : stats) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("hashespersec", thread_stats.dHashesPerSec));
+        entry.push_back(Pair("hashes", thread_stats.nHashes));
+        entry.push_back(Pair("blocks", thread_stats.nBlocks));
+        threads.push_back(entry);
+        dHashesPerSec += thread_stats.dHashesPerSec;
+        nHashes += thread_stats.nHashes;
+        nBlocks += thread_stats.nBlocks;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("generate", !stats.empty()));
+    obj.push_back(Pair("hashespersec", dHashesPerSec));
+    obj.push_back(Pair("hashes", nHashes));
+    obj.push_back(Pair("blocks", nBlocks));
+    obj.push_back(Pair("threads", threads));
+    return obj;
+}
+
 UniValue getmininginfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -499,34 +594,22 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     bool fSupportsSegwit = setClientRules.find("segwit") != setClientRules.end();
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    // Cache whether the last invocation was with segwit support, to avoid returning
-    // a segwit-block to a non-segwit caller.
-    static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit)
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-        fLastTemplateSupportsSegwit = fSupportsSegwit;
+    // The template is kept up to date with the mempool between calls, and
+    // only assembled from scratch on a new tip or when appending new
+    // transactions cannot reflect the mempool (see IncrementalBlockAssembler).
+    static std::unique_ptr<IncrementalBlockAssembler> incremental_assembler;
+    if (!incremental_assembler)
+        incremental_assembler.reset(new IncrementalBlockAssembler(Params()));
+
+    // Store the counter before updating the template, to avoid races
+    nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+    CBlockIndex* const pindexPrev = chainActive.Tip();
+
+    CScript scriptDummy = CScript() << OP_TRUE;
+    CBlockTemplate* pblocktemplate = incremental_assembler->GetBlockTemplate(scriptDummy, fSupportsSegwit, 5);
+    if (!pblocktemplate)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fSupportsSegwit);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
-    }
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
@@ -969,6 +1052,8 @@ static const CRPCCommand commands[] =
 
 
     { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
+    { "generating",         "setgenerate",            &setgenerate,            {"generate","genproclimit","address"} },
+    { "generating",         "getminerinfo",           &getminerinfo,           {} },
 
     { "util",               "estimatefee",            &estimatefee,            {"nblocks"} },
     { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
@@ -66,6 +66,44 @@ UniValue ping(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue TimeHistogramToJSON(const CTimeHistogram& histogram)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("count", histogram.nCount));
+    obj.push_back(Pair("total", histogram.nTotalMicros));
+    obj.push_back(Pair("max", histogram.nMaxMicros));
+    // Leave out the empty buckets at the long end
+    int nBuckets = CTimeHistogram::NUM_BUCKETS;
+    while (nBuckets > 0 && histogram.vBuckets[nBuckets - 1] == 0)
+        nBuckets--;
+    UniValue buckets(UniValue::VARR);
+    for (int i = 0; i < nBuckets; i++)
+        buckets.push_back(histogram.vBuckets[i]);
+    obj.push_back(Pair("buckets", buckets));
+    return obj;
+}
+
+static void MsgCmdTimeToJSON(const mapMsgCmdTime& mapTime, UniValue& queuePerMsgCmd, UniValue& processPerMsgCmd)
+{
+    for (const mapMsgCmdTime::value_type &i : mapTime) {
+        if (i.second.queue.nCount > 0)
+            queuePerMsgCmd.push_back(Pair(i.first, TimeHistogramToJSON(i.second.queue)));
+        if (i.second.process.nCount > 0)
+            processPerMsgCmd.push_back(Pair(i.first, TimeHistogramToJSON(i.second.process)));
+    }
+}
+
+// Shared by the help of getpeerinfo and getnetstats
+static const std::string strTimeHistogramHelp =
+    "       \"addr\": {             (json object) Histogram of the time messages of this type took, in microseconds\n"
+    "         \"count\": n,         (numeric) The number of messages\n"
+    "         \"total\": n,         (numeric) The total time\n"
+    "         \"max\": n,           (numeric) The longest time\n"
+    "         \"buckets\": [n,...]  (array) Message counts by time, bucket i counts the times below 2^i\n"
+    "                               that are not in a lower bucket, empty buckets at the end are left out\n"
+    "       },\n"
+    "       ...\n";
+
 UniValue getpeerinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -110,6 +148,12 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"queuetime_per_msg\": {   (json object) Time received messages waited to be processed, by message type\n"
+            + strTimeHistogramHelp +
+            "    },\n"
+            "    \"processtime_per_msg\": { (json object) Time received messages took to process, by message type\n"
+            + strTimeHistogramHelp +
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -185,6 +229,12 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
 
+        UniValue queuePerMsgCmd(UniValue::VOBJ);
+        UniValue processPerMsgCmd(UniValue::VOBJ);
+        MsgCmdTimeToJSON(stats.mapTimePerMsgCmd, queuePerMsgCmd, processPerMsgCmd);
+        obj.push_back(Pair("queuetime_per_msg", queuePerMsgCmd));
+        obj.push_back(Pair("processtime_per_msg", processPerMsgCmd));
+
         ret.push_back(obj);
     }
 
@@ -393,6 +443,79 @@ UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getnetstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getnetstats\n"
+            "\nReturns how long received messages waited to be processed and took to process,\n"
+            "by message type for all peers since startup, and by connected peer.\n"
+            "Times are in microseconds.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"queuetime_per_msg\": {     (json object) Time messages waited to be processed, by message type\n"
+            + strTimeHistogramHelp +
+            "  },\n"
+            "  \"processtime_per_msg\": {   (json object) Time messages took to process, by message type\n"
+            + strTimeHistogramHelp +
+            "  },\n"
+            "  \"peers\": [                 (array) The connected peers, the one with the most processing time first\n"
+            "    {\n"
+            "      \"id\": n,               (numeric) Peer index\n"
+            "      \"addr\":\"host:port\",    (string) The IP address and port of the peer\n"
+            "      \"msgcount\": n,         (numeric) The number of messages processed\n"
+            "      \"queuetime\": n,        (numeric) The total time messages waited to be processed\n"
+            "      \"processtime\": n       (numeric) The total time messages took to process\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnetstats", "")
+            + HelpExampleRpc("getnetstats", "")
+       );
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    UniValue obj(UniValue::VOBJ);
+    mapMsgCmdTime mapTime;
+    g_connman->GetMessageTimeStats(mapTime);
+    UniValue queuePerMsgCmd(UniValue::VOBJ);
+    UniValue processPerMsgCmd(UniValue::VOBJ);
+    MsgCmdTimeToJSON(mapTime, queuePerMsgCmd, processPerMsgCmd);
+    obj.push_back(Pair("queuetime_per_msg", queuePerMsgCmd));
+    obj.push_back(Pair("processtime_per_msg", processPerMsgCmd));
+
+    std::vector<CNodeStats> vstats;
+    g_connman->GetNodeStats(vstats);
+    std::vector<std::pair<int64_t, UniValue>> vPeers;
+    for (const CNodeStats& stats : vstats) {
+        uint64_t nCount = 0;
+        int64_t nQueueMicros = 0;
+        int64_t nProcessMicros = 0;
+        for (const mapMsgCmdTime::value_type &i : stats.mapTimePerMsgCmd) {
+            nCount += i.second.queue.nCount;
+            nQueueMicros += i.second.queue.nTotalMicros;
+            nProcessMicros += i.second.process.nTotalMicros;
+        }
+        UniValue peer(UniValue::VOBJ);
+        peer.push_back(Pair("id", stats.nodeid));
+        peer.push_back(Pair("addr", stats.addrName));
+        peer.push_back(Pair("msgcount", nCount));
+        peer.push_back(Pair("queuetime", nQueueMicros));
+        peer.push_back(Pair("processtime", nProcessMicros));
+        vPeers.emplace_back(nProcessMicros, std::move(peer));
+    }
+    std::stable_sort(vPeers.begin(), vPeers.end(), [](const std::pair<int64_t, UniValue>& a, const std::pair<int64_t, UniValue>& b) {
+        return a.first > b.first;
+    });
+    UniValue peers(UniValue::VARR);
+    for (auto& peer : vPeers)
+        peers.push_back(peer.second);
+    obj.push_back(Pair("peers", peers));
+    return obj;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -635,6 +758,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getnetstats",            &getnetstats,            {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
@@ -0,0 +1,199 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KUSACOIN_SUPPORT_ALLOCATORS_POOL_H
+#define KUSACOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource for node based containers, which allocate one element at
+ * a time. Blocks of up to MAX_BLOCK_SIZE_BYTES are carved out of large chunks,
+ * and freed blocks are kept in one free list per size for reuse. Memory is only
+ * given back to the system when the resource is destroyed.
+ *
+ * Compared to calling malloc for every node this saves the per-allocation
+ * bookkeeping and keeps nodes that were allocated together close together.
+ * Larger blocks (such as the bucket array of an unordered_map) and blocks with
+ * a stricter alignment go to ::operator new.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+private:
+    //! A freed block, linking to the next free block of the same size
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    //! Blocks are handed out in multiples of this, and aligned to it
+    static constexpr std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > sizeof(ListNode) ? ALIGN_BYTES : sizeof(ListNode);
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+    static_assert(ELEM_ALIGN_BYTES % alignof(ListNode) == 0, "blocks must be able to hold a ListNode");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= ELEM_ALIGN_BYTES, "MAX_BLOCK_SIZE_BYTES too small");
+    static_assert(MAX_BLOCK_SIZE_BYTES % ELEM_ALIGN_BYTES == 0, "MAX_BLOCK_SIZE_BYTES must be a multiple of the alignment");
+
+    const std::size_t m_chunk_size_bytes;
+    //! All chunks allocated so far
+    std::list<void*> m_allocated_chunks;
+    //! Free lists, indexed by the block size in multiples of ELEM_ALIGN_BYTES
+    std::vector<ListNode*> m_free_lists;
+    //! Unused part of the most recent chunk
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+    //! Bytes in the free lists
+    std::size_t m_free_bytes = 0;
+
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PlacementAddToList(void* p, ListNode*& node)
+    {
+        node = new (p) ListNode{node};
+    }
+
+    //! Start a new chunk, moving what is left of the current one to the free lists
+    void AllocateChunk()
+    {
+        if (m_available_memory_it) {
+            const std::size_t remaining = m_available_memory_end - m_available_memory_it;
+            if (remaining) {
+                PlacementAddToList(m_available_memory_it, m_free_lists[remaining / ELEM_ALIGN_BYTES]);
+                m_free_bytes += remaining;
+            }
+        }
+        void* storage = ::operator new(m_chunk_size_bytes);
+        m_available_memory_it = static_cast<char*>(storage);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+        m_allocated_chunks.push_back(storage);
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes)
+        : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES),
+          m_free_lists(MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        // Chunks come from ::operator new, which aligns for any fundamental type
+        static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "chunks are not aligned enough");
+        AllocateChunk();
+    }
+
+    PoolResource() : PoolResource(262144) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            ListNode*& free_list = m_free_lists[num_alignments];
+            const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+            if (free_list) {
+                ListNode* block = free_list;
+                free_list = block->m_next;
+                m_free_bytes -= round_bytes;
+                return block;
+            }
+            if (static_cast<std::size_t>(m_available_memory_end - m_available_memory_it) < round_bytes) {
+                AllocateChunk();
+            }
+            void* block = m_available_memory_it;
+            m_available_memory_it += round_bytes;
+            return block;
+        }
+        return ::operator new(bytes);
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            PlacementAddToList(p, m_free_lists[num_alignments]);
+            m_free_bytes += num_alignments * ELEM_ALIGN_BYTES;
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+    //! Bytes of the chunks that are not handed out: the free lists and the rest of the current chunk
+    std::size_t NumFreeBytes() const { return m_free_bytes + (m_available_memory_end - m_available_memory_it); }
+};
+
+/**
+ * Allocator that takes its memory from a PoolResource, which has to outlive
+ * every container using it.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+private:
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // KUSACOIN_SUPPORT_ALLOCATORS_POOL_H
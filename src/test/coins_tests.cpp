@@ -53,7 +53,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -64,7 +64,11 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (fErase) {
+                mapCoins.erase(it++);
+            } else {
+                ++it;
+            }
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -121,6 +125,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     bool found_an_entry = false;
     bool missed_an_entry = false;
     bool uncached_an_entry = false;
+    bool synced_a_cache = false;
 
     // A simple map to track what we expect the cache stack to represent.
     std::map<COutPoint, Coin> result;
@@ -211,7 +216,14 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             // Every 100 iterations, flush an intermediate cache
             if (stack.size() > 1 && InsecureRandBool() == 0) {
                 unsigned int flushIndex = InsecureRandRange(stack.size() - 1);
-                stack[flushIndex]->Flush();
+                if (InsecureRandBool()) {
+                    stack[flushIndex]->Flush();
+                } else {
+                    // Keep the entries, and drop a random part of them
+                    stack[flushIndex]->Sync();
+                    stack[flushIndex]->EvictClean(InsecureRandRange(stack[flushIndex]->DynamicMemoryUsage() + 1));
+                    synced_a_cache = true;
+                }
             }
         }
         if (InsecureRandRange(100) == 0) {
@@ -254,6 +266,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(found_an_entry);
     BOOST_CHECK(missed_an_entry);
     BOOST_CHECK(uncached_an_entry);
+    BOOST_CHECK(synced_a_cache);
 }
 
 // Store of all necessary tx and undo data for next test
@@ -587,9 +600,10 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
-    view.BatchWrite(map, {});
+    view.BatchWrite(map, {}, true);
 }
 
 class SingleEntryCacheTest
@@ -856,4 +870,74 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_sync_evict)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetBestBlock(InsecureRand256());
+
+    // Enough coins to fill several chunks of the pool
+    const uint32_t nCoins = 10000;
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < nCoins; i++) {
+        outpoints.emplace_back(InsecureRand256(), 0);
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(i + 1, CScript() << OP_TRUE), i + 1, false), false);
+    }
+    cache.Flush();
+    for (const COutPoint& outpoint : outpoints) {
+        cache.AccessCoin(outpoint);
+    }
+
+    // Modify an old coin, spend one and add a new one
+    const COutPoint modified(outpoints[1]);
+    cache.SpendCoin(modified);
+    cache.AddCoin(modified, Coin(CTxOut(1, CScript() << OP_FALSE), 2, false), true);
+    cache.SpendCoin(outpoints[0]);
+    const COutPoint added(InsecureRand256(), 0);
+    cache.AddCoin(added, Coin(CTxOut(1, CScript() << OP_TRUE), nCoins + 1000, false), false);
+
+    // Syncing writes the changes, keeps the unspent entries and makes them clean
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size());
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.second.flags, 0);
+    }
+    Coin coin;
+    BOOST_CHECK(!base.GetCoin(outpoints[0], coin) || coin.IsSpent());
+    BOOST_CHECK(base.GetCoin(modified, coin) && coin.out.scriptPubKey == (CScript() << OP_FALSE));
+    BOOST_CHECK(base.GetCoin(added, coin) && coin.nHeight == nCoins + 1000);
+    cache.SelfTest();
+
+    // Nothing is evicted while the cache is small enough
+    BOOST_CHECK_EQUAL(cache.EvictClean(cache.DynamicMemoryUsage()), 0U);
+
+    // A modified entry is kept, whatever its height
+    const COutPoint dirty(outpoints[2]);
+    cache.SpendCoin(dirty);
+    cache.AddCoin(dirty, Coin(CTxOut(2, CScript() << OP_TRUE), 3, false), true);
+
+    // Evicting stops once the memory in use is below the target. The pool
+    // keeps the memory of the evicted entries for new ones.
+    const size_t usage = cache.DynamicMemoryUsage();
+    const size_t target = (usage - cache.FreeMemoryUsage()) / 2;
+    const size_t evicted = cache.EvictClean(target);
+    BOOST_CHECK_GT(evicted, 0U);
+    BOOST_CHECK_LE(cache.DynamicMemoryUsage() - cache.FreeMemoryUsage(), target);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), usage);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() - evicted);
+    BOOST_CHECK(cache.HaveCoinInCache(dirty));
+    cache.SelfTest();
+
+    // New entries reuse that memory
+    for (size_t i = 0; i < evicted; i++) {
+        cache.AddCoin(COutPoint(InsecureRand256(), 0), Coin(CTxOut(1, CScript() << OP_TRUE), nCoins + 1000, false), false);
+    }
+    BOOST_CHECK_LE(cache.DynamicMemoryUsage(), usage);
+
+    // Evicted coins are still found in the base
+    BOOST_CHECK(cache.HaveCoin(outpoints[3]));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(base.GetCoin(dirty, coin) && coin.out.nValue == 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
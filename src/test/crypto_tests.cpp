@@ -5,13 +5,17 @@
 
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
+#include <primitives/block.h>
 #include <random.h>
+#include <streams.h>
 #include <utilstrencodings.h>
 #include <test/test_kusacoin.h>
 
@@ -525,6 +529,119 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+static std::string MuHashHex(const MuHash3072& muhash)
+{
+    unsigned char hash[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_testvector)
+{
+    // Computed with a separate implementation using big integers
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    MuHash3072 muhash;
+    for (unsigned char i = 0; i < 3; i++) {
+        muhash *= MuHash3072(&i, 1);
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(muhash), "f2c7635c44d7abd9d48e9c06b5dd3238621ae95a3a75039d4154c5aaac9a9584");
+    muhash = MuHash3072();
+    std::string str;
+    for (int i = 1; i < 50; i++) {
+        str += "abc";
+        muhash *= MuHash3072((const unsigned char*)str.data(), str.size());
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(muhash), "aee84952860aec3164e7e430e648c1a591229fd094dc83f9610230d639c67ac7");
+
+    // The order does not matter, and sets can be hashed in parts
+    std::vector<MuHash3072> elements;
+    for (int i = 0; i < 10; i++) {
+        uint256 data = InsecureRand256();
+        elements.emplace_back(data.begin(), data.size());
+    }
+    MuHash3072 forward, backward, first_half, second_half;
+    for (int i = 0; i < 10; i++) {
+        forward *= elements[i];
+        backward *= elements[9 - i];
+        (i < 5 ? first_half : second_half) *= elements[i];
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(forward), MuHashHex(backward));
+    BOOST_CHECK_EQUAL(MuHashHex(forward), MuHashHex(second_half *= first_half));
+    BOOST_CHECK(MuHashHex(forward) != MuHashHex(first_half));
+}
+
+BOOST_AUTO_TEST_CASE(lyra2rev2_scratch_testvector)
+{
+    // Mainnet genesis block header
+    CBlockHeader header;
+    header.nVersion = 2;
+    header.hashMerkleRoot = uint256S("0xd10a2acbf61e1dd85ff0abc9206938b73c3e16722980a137cefdee9262ac7b45");
+    header.nTime = 1531062000;
+    header.nBits = 0x1e00ffff;
+    header.nNonce = 9987283;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    BOOST_CHECK_EQUAL(ss.size(), 80U);
+
+    const uint256 expected = uint256S("0x0000003acb5e87c6ad4985175506885cc88a0acf2fe8e398e1bb681274ea6f8c");
+    uint256 hash;
+    lyra2re2_hash(ss.data(), reinterpret_cast<char*>(hash.begin()));
+    BOOST_CHECK_EQUAL(hash, expected);
+
+    // The scratch arena is wiped after every call, so reusing it must give the same result
+    alignas(LYRA2RE2_SCRATCH_ALIGN) unsigned char scratch[LYRA2RE2_SCRATCH_SIZE];
+    for (int i = 0; i < 2; i++) {
+        hash.SetNull();
+        lyra2re2_hash_scratch(ss.data(), reinterpret_cast<char*>(hash.begin()), scratch);
+        BOOST_CHECK_EQUAL(hash, expected);
+    }
+    BOOST_CHECK_EQUAL(header.GetHash(), expected);
+
+    // Random inputs agree between the allocating and the scratch variants
+    FastRandomContext ctx(true);
+    for (int i = 0; i < 16; i++) {
+        std::vector<unsigned char> in = ctx.randbytes(80);
+        uint256 hash1, hash2;
+        lyra2re2_hash(reinterpret_cast<const char*>(in.data()), reinterpret_cast<char*>(hash1.begin()));
+        lyra2re2_hash_scratch(reinterpret_cast<const char*>(in.data()), reinterpret_cast<char*>(hash2.begin()), scratch);
+        BOOST_CHECK_EQUAL(hash1, hash2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_hash_cache)
+{
+    FastRandomContext ctx(true);
+    CBlock block;
+    block.nVersion = 2;
+    block.hashPrevBlock = ctx.rand256();
+    block.hashMerkleRoot = ctx.rand256();
+    block.nTime = 1531062000;
+    block.nBits = 0x1e00ffff;
+
+    const uint256 hash = block.GetHash();
+    BOOST_CHECK_EQUAL(hash, block.CBlockHeader::GetHash());
+    BOOST_CHECK_EQUAL(block.GetHash(), hash);
+
+    // Modifying any header field must not return a stale hash
+    block.nNonce++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK_EQUAL(block.GetHash(), block.CBlockHeader::GetHash());
+    block.hashMerkleRoot = ctx.rand256();
+    BOOST_CHECK_EQUAL(block.GetHash(), block.CBlockHeader::GetHash());
+    block.nNonce--;
+    block.SetNull();
+    BOOST_CHECK_EQUAL(block.GetHash(), block.CBlockHeader::GetHash());
+
+    // Copies (including the memo) hash their own header
+    CBlock copy(block);
+    BOOST_CHECK_EQUAL(copy.GetHash(), block.GetHash());
+    copy.nTime++;
+    BOOST_CHECK_EQUAL(copy.GetHash(), copy.CBlockHeader::GetHash());
+    BOOST_CHECK(copy.GetHash() != block.GetHash());
+    block = copy;
+    BOOST_CHECK_EQUAL(block.GetHash(), copy.GetHash());
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -7,6 +7,7 @@
 #include <uint256.h>
 #include <random.h>
 #include <test/test_kusacoin.h>
+#include <txdb.h>
 
 #include <memory>
 
@@ -320,4 +321,48 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_options_and_stats)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBOptions options(1 << 20);
+    options.nWriteBufferSize = 64 << 10;
+    options.nBloomBitsPerKey = 0;
+    CDBWrapper dbw(ph, options, false, true, false);
+    BOOST_CHECK_EQUAL(dbw.GetDBOptions().nWriteBufferSize, options.nWriteBufferSize);
+
+    // Enough data to fill several write buffers
+    for (uint32_t i = 0; i < 2000; i++) {
+        BOOST_CHECK(dbw.Write(std::make_pair('k', i), InsecureRand256()));
+    }
+    BOOST_CHECK_GT(dbw.GetMemoryUsage(), 0U);
+    dbw.CompactRawRange("", "");
+    BOOST_CHECK_GT(dbw.EstimateRawSize("", ""), 2000U * 32);
+    BOOST_CHECK_EQUAL(dbw.EstimateRawSize("l", ""), 0U);
+    int files = 0;
+    for (const CDBLevelStats& level : dbw.GetLevelStats()) {
+        files += level.nFiles;
+    }
+    BOOST_CHECK_GT(files, 0);
+    BOOST_CHECK(dbw.GetProperty("leveldb.no-such-property").empty());
+
+    uint256 value;
+    BOOST_CHECK(dbw.Read(std::make_pair('k', (uint32_t)1999), value));
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_options_from_args)
+{
+    gArgs.ForceSetArg("-chainstatewritebuffer", "8");
+    gArgs.ForceSetArg("-chainstatebloombits", "0");
+    CDBOptions options = GetDBOptions("chainstate", 1 << 20);
+    BOOST_CHECK_EQUAL(options.nCacheSize, 1U << 20);
+    BOOST_CHECK_EQUAL(options.nWriteBufferSize, 8U << 20);
+    BOOST_CHECK_EQUAL(options.nBloomBitsPerKey, 0);
+    // Other databases keep the defaults
+    options = GetDBOptions("blockindex", 1 << 20);
+    BOOST_CHECK_EQUAL(options.nWriteBufferSize, 0U);
+    BOOST_CHECK_EQUAL(options.nBloomBitsPerKey, 10);
+    gArgs.ForceSetArg("-chainstatewritebuffer", "0");
+    gArgs.ForceSetArg("-chainstatebloombits", "10");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -419,6 +419,86 @@ BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
 }
 
 
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest)
+{
+    // removeForBlock updates the ancestor and descendant state of the
+    // transactions that stay as removing the confirmed ones one by one does
+    SeedInsecureRand();
+    TestMemPoolEntryHelper entry;
+    for (int nRun = 0; nRun < 10; nRun++) {
+        // A random graph of transactions, and a random set of them confirmed.
+        // Like in a valid block, the parents of a confirmed transaction are confirmed.
+        std::vector<CTransactionRef> vtxAll;
+        std::vector<CTransactionRef> vtxBlock;
+        std::set<uint256> setBlockHashes;
+        std::vector<COutPoint> vUnspent;
+        for (int i = 0; i < 60; i++) {
+            CMutableTransaction tx;
+            int nInputs = InsecureRandRange(4);
+            for (int j = 0; j < nInputs && !vUnspent.empty(); j++) {
+                size_t nIndex = InsecureRandRange(vUnspent.size());
+                tx.vin.emplace_back(vUnspent[nIndex]);
+                vUnspent.erase(vUnspent.begin() + nIndex);
+            }
+            if (tx.vin.empty()) {
+                tx.vin.resize(1);
+                tx.vin[0].scriptSig = CScript() << nRun << i;
+            }
+            tx.vout.resize(3);
+            for (CTxOut& txout : tx.vout) {
+                txout.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+                txout.nValue = COIN;
+            }
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            vtxAll.push_back(ptx);
+            bool fParentsConfirmed = true;
+            for (const CTxIn& txin : ptx->vin) {
+                if (!txin.prevout.IsNull() && !setBlockHashes.count(txin.prevout.hash)) fParentsConfirmed = false;
+            }
+            if (fParentsConfirmed && InsecureRandRange(3)) {
+                vtxBlock.push_back(ptx);
+                setBlockHashes.insert(ptx->GetHash());
+            }
+            for (uint32_t n = 0; n < tx.vout.size(); n++) {
+                vUnspent.emplace_back(ptx->GetHash(), n);
+            }
+        }
+
+        CTxMemPool pool;
+        CTxMemPool poolExpected;
+        for (const CTransactionRef& tx : vtxAll) {
+            CAmount nFee = InsecureRandRange(10000);
+            unsigned int nSigOps = InsecureRandRange(100);
+            pool.addUnchecked(tx->GetHash(), entry.Fee(nFee).SigOpsCost(nSigOps).FromTx(*tx));
+            poolExpected.addUnchecked(tx->GetHash(), entry.Fee(nFee).SigOpsCost(nSigOps).FromTx(*tx));
+        }
+
+        pool.removeForBlock(vtxBlock, 1);
+        LOCK2(pool.cs, poolExpected.cs);
+        for (const CTransactionRef& tx : vtxBlock) {
+            CTxMemPool::setEntries stage;
+            stage.insert(poolExpected.mapTx.find(tx->GetHash()));
+            poolExpected.RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+        }
+
+        BOOST_CHECK_EQUAL(pool.size(), vtxAll.size() - vtxBlock.size());
+        BOOST_CHECK_EQUAL(pool.size(), poolExpected.size());
+        BOOST_CHECK_EQUAL(pool.GetTotalTxSize(), poolExpected.GetTotalTxSize());
+        BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), poolExpected.DynamicMemoryUsage());
+        for (const CTxMemPoolEntry& e : pool.mapTx) {
+            auto it = poolExpected.mapTx.find(e.GetTx().GetHash());
+            BOOST_CHECK(it != poolExpected.mapTx.end());
+            BOOST_CHECK_EQUAL(e.GetCountWithAncestors(), it->GetCountWithAncestors());
+            BOOST_CHECK_EQUAL(e.GetSizeWithAncestors(), it->GetSizeWithAncestors());
+            BOOST_CHECK_EQUAL(e.GetModFeesWithAncestors(), it->GetModFeesWithAncestors());
+            BOOST_CHECK_EQUAL(e.GetSigOpCostWithAncestors(), it->GetSigOpCostWithAncestors());
+            BOOST_CHECK_EQUAL(e.GetCountWithDescendants(), it->GetCountWithDescendants());
+            BOOST_CHECK_EQUAL(e.GetSizeWithDescendants(), it->GetSizeWithDescendants());
+            BOOST_CHECK_EQUAL(e.GetModFeesWithDescendants(), it->GetModFeesWithDescendants());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
     CTxMemPool pool;
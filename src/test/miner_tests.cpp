@@ -13,6 +13,7 @@
 #include <miner.h>
 #include <policy/policy.h>
 #include <pubkey.h>
+#include <script/interpreter.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
@@ -523,4 +524,129 @@ void TestPackageSelection(const CChainParams& chainparams, CScript scriptPubKey,
 //     fCheckpointsEnabled = true;
 // }
 
+BOOST_FIXTURE_TEST_CASE(internal_miner, TestChain100Setup)
+{
+    int nHeightStart;
+    {
+        LOCK(cs_main);
+        nHeightStart = chainActive.Height();
+    }
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    BOOST_CHECK(GetMinerThreadStats().empty());
+    GenerateKusacoins(true, 2, scriptPubKey, Params());
+    BOOST_CHECK_EQUAL(GetMinerThreadStats().size(), 2U);
+
+    // Regtest blocks take a couple of hashes, wait for the threads to build on each other's blocks
+    int nHeight = nHeightStart;
+    for (int i = 0; i < 600 && nHeight < nHeightStart + 5; i++) {
+        MilliSleep(100);
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+    GenerateKusacoins(false, 0, CScript(), Params());
+    BOOST_CHECK(GetMinerThreadStats().empty());
+    BOOST_CHECK_GE(nHeight, nHeightStart + 5);
+
+    LOCK(cs_main);
+    for (const CBlockIndex* pindex = chainActive.Tip(); pindex->nHeight > nHeightStart; pindex = pindex->pprev) {
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        BOOST_CHECK(block.vtx[0]->vout[0].scriptPubKey == scriptPubKey);
+    }
+}
+
+//! A transaction spending output 0 of prev to scriptPubKey, leaving nFee
+static CMutableTransaction SignedSpend(const CTransaction& prev, const CScript& scriptPubKey, const CKey& key, CAmount nFee)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prev.GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = prev.vout[0].nValue - nFee;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(prev.vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+//! Check that the template is a valid block on the tip with nTx transactions
+static void CheckTemplate(const CBlockTemplate* pblocktemplate, size_t nTx)
+{
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), nTx);
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees.size(), nTx);
+    CAmount nFees = 0;
+    for (size_t i = 1; i < pblocktemplate->vTxFees.size(); i++)
+        nFees += pblocktemplate->vTxFees[i];
+    BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], -nFees);
+
+    CValidationState state;
+    BOOST_CHECK(TestBlockValidity(state, Params(), pblocktemplate->block, chainActive.Tip(), false, false));
+}
+
+BOOST_FIXTURE_TEST_CASE(incremental_block_template, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    IncrementalBlockAssembler incremental(Params());
+    TestMemPoolEntryHelper entry;
+    entry.SpendsCoinbase(true);
+
+    // Let the first three coinbases mature
+    CreateAndProcessBlock({}, scriptPubKey);
+    CreateAndProcessBlock({}, scriptPubKey);
+
+    CMutableTransaction tx_a, tx_b, tx_c, tx_d, tx_e;
+    {
+        LOCK2(cs_main, mempool.cs);
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 1);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 1U);
+
+        // New transactions are appended
+        tx_a = SignedSpend(coinbaseTxns[0], scriptPubKey, coinbaseKey, 10000);
+        tx_b = SignedSpend(coinbaseTxns[1], scriptPubKey, coinbaseKey, 20000);
+        mempool.addUnchecked(tx_a.GetHash(), entry.Fee(10000).FromTx(tx_a));
+        mempool.addUnchecked(tx_b.GetHash(), entry.Fee(20000).FromTx(tx_b));
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 3);
+        tx_c = SignedSpend(tx_a, scriptPubKey, coinbaseKey, 10000);
+        mempool.addUnchecked(tx_c.GetHash(), entry.Fee(10000).SpendsCoinbase(false).FromTx(tx_c));
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 4);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 1U);
+
+        // A transaction below the minimum feerate is left out, its child
+        // (with a fee paying for both) waits for a rebuild
+        tx_d = SignedSpend(coinbaseTxns[2], scriptPubKey, coinbaseKey, 0);
+        mempool.addUnchecked(tx_d.GetHash(), entry.Fee(0).SpendsCoinbase(true).FromTx(tx_d));
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 4);
+        tx_e = SignedSpend(tx_d, scriptPubKey, coinbaseKey, 50000);
+        mempool.addUnchecked(tx_e.GetHash(), entry.Fee(50000).SpendsCoinbase(false).FromTx(tx_e));
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 4);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 1U);
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 0), 6);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 2U);
+
+        // Fee deltas and removals of template transactions force a rebuild
+        mempool.PrioritiseTransaction(tx_b.GetHash(), 1000);
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 6);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 3U);
+        mempool.removeRecursive(tx_b, MemPoolRemovalReason::CONFLICT);
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 5);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 4U);
+
+        // Nothing changed
+        CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 5);
+        BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 4U);
+    }
+
+    // So does a new tip
+    CreateAndProcessBlock({tx_a, tx_c, tx_d, tx_e}, scriptPubKey);
+    LOCK2(cs_main, mempool.cs);
+    CheckTemplate(incremental.GetBlockTemplate(scriptPubKey, true, 5), 1);
+    BOOST_CHECK_EQUAL(incremental.GetFullBuilds(), 5U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
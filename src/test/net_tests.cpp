@@ -14,7 +14,12 @@
 #include <chainparams.h>
 #include <util.h>
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 class CAddrManSerializationMock : public CAddrMan
 {
@@ -188,4 +193,274 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(time_histogram)
+{
+    CTimeHistogram histogram;
+    histogram.Add(0);
+    histogram.Add(1);
+    histogram.Add(2);
+    histogram.Add(3);
+    histogram.Add(4);
+    histogram.Add(1000);
+    histogram.Add(-5); // clock went backwards, counted as no time
+    histogram.Add(std::numeric_limits<int64_t>::max() / 2);
+
+    BOOST_CHECK_EQUAL(histogram.nCount, 8U);
+    BOOST_CHECK_EQUAL(histogram.nMaxMicros, std::numeric_limits<int64_t>::max() / 2);
+    BOOST_CHECK_EQUAL(histogram.vBuckets[0], 2U); // 0, -5
+    BOOST_CHECK_EQUAL(histogram.vBuckets[1], 1U); // 1
+    BOOST_CHECK_EQUAL(histogram.vBuckets[2], 2U); // 2, 3
+    BOOST_CHECK_EQUAL(histogram.vBuckets[3], 1U); // 4
+    BOOST_CHECK_EQUAL(histogram.vBuckets[10], 1U); // 1000 is below 2^10
+    BOOST_CHECK_EQUAL(histogram.vBuckets[CTimeHistogram::NUM_BUCKETS - 1], 1U);
+
+    uint64_t nBucketed = 0;
+    for (uint64_t nBucket : histogram.vBuckets)
+        nBucketed += nBucket;
+    BOOST_CHECK_EQUAL(nBucketed, histogram.nCount);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(push_shared_message)
+{
+    CConnman connman(0x1337, 0x1337);
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+
+    std::vector<unsigned char> payload(20000);
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = i * 7;
+    CSerializedNetMsg msg;
+    msg.command = "block";
+    msg.data = payload;
+    CSharedNetMsg shared = MakeSharedNetMsg(std::move(msg));
+    const size_t nHeaderSize = CMessageHeader::HEADER_SIZE;
+    BOOST_CHECK_EQUAL(shared.header->size(), nHeaderSize);
+    BOOST_CHECK(*shared.data == payload);
+
+    // A node without a socket keeps the message queued, referencing the shared buffers
+    std::unique_ptr<CNode> pnodeQueued(new CNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false));
+    connman.PushMessage(pnodeQueued.get(), shared);
+    connman.PushMessage(pnodeQueued.get(), shared);
+    {
+        LOCK(pnodeQueued->cs_vSend);
+        BOOST_CHECK_EQUAL(pnodeQueued->vSendMsg.size(), 4U);
+        BOOST_CHECK(pnodeQueued->vSendMsg[0] == shared.header);
+        BOOST_CHECK(pnodeQueued->vSendMsg[1] == shared.data);
+        BOOST_CHECK(pnodeQueued->vSendMsg[3] == shared.data);
+        BOOST_CHECK_EQUAL(pnodeQueued->nSendSize, 2 * (nHeaderSize + payload.size()));
+    }
+
+    // Peers with a socket get header and payload gathered into one write
+    for (int n = 0; n < 2; n++) {
+        int fds[2];
+        BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        std::unique_ptr<CNode> pnode(new CNode(n + 1, NODE_NETWORK, 0, fds[0], addr, 0, 0, CAddress(), "", false));
+        connman.PushMessage(pnode.get(), shared);
+        {
+            LOCK(pnode->cs_vSend);
+            BOOST_CHECK(pnode->vSendMsg.empty());
+            BOOST_CHECK_EQUAL(pnode->nSendSize, 0U);
+            BOOST_CHECK_EQUAL(pnode->nSendBytes, nHeaderSize + payload.size());
+        }
+
+        std::vector<unsigned char> received(CMessageHeader::HEADER_SIZE + payload.size());
+        size_t nRead = 0;
+        while (nRead < received.size()) {
+            ssize_t nBytes = read(fds[1], received.data() + nRead, received.size() - nRead);
+            BOOST_REQUIRE(nBytes > 0);
+            nRead += nBytes;
+        }
+        close(fds[1]);
+
+        CDataStream ssHeader(std::vector<unsigned char>(received.begin(), received.begin() + CMessageHeader::HEADER_SIZE), SER_NETWORK, PROTOCOL_VERSION);
+        CMessageHeader hdr(Params().MessageStart());
+        ssHeader >> hdr;
+        BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+        BOOST_CHECK_EQUAL(hdr.GetCommand(), "block");
+        BOOST_CHECK_EQUAL(hdr.nMessageSize, payload.size());
+        uint256 hash = Hash(payload.begin(), payload.end());
+        BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+        BOOST_CHECK(std::equal(payload.begin(), payload.end(), received.begin() + CMessageHeader::HEADER_SIZE));
+    }
+}
+BOOST_AUTO_TEST_CASE(socket_events_mode)
+{
+    SocketEventsMode mode = DEFAULT_SOCKETEVENTS;
+    BOOST_CHECK(ParseSocketEventsMode("select", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_SELECT);
+#ifdef USE_EPOLL
+    BOOST_CHECK(ParseSocketEventsMode("epoll", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_EPOLL);
+#else
+    BOOST_CHECK(!ParseSocketEventsMode("epoll", mode));
+#endif
+    BOOST_CHECK(!ParseSocketEventsMode("", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("kqueue", mode));
+}
+
+BOOST_AUTO_TEST_CASE(socket_events)
+{
+    std::vector<SocketEventsMode> vModes{SOCKETEVENTS_SELECT};
+#ifdef USE_EPOLL
+    vModes.push_back(SOCKETEVENTS_EPOLL);
+#endif
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+
+    for (SocketEventsMode mode : vModes) {
+        CConnman connman(0x1337, 0x1337);
+        BOOST_REQUIRE(CConnmanTest::InitSocketEvents(connman, mode));
+        int fds[2];
+        BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        std::unique_ptr<CNode> pnode(new CNode(0, NODE_NETWORK, 0, fds[0], addr, 0, 0, CAddress(), "", false));
+        CConnmanTest::AddNode(connman, *pnode);
+        std::set<SOCKET> recv_set, send_set, error_set;
+
+        // Nothing happens until the timeout
+        CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+        BOOST_CHECK(recv_set.empty() && send_set.empty() && error_set.empty());
+
+        // Data to receive is reported until it is read, unless receiving is paused
+        BOOST_REQUIRE(write(fds[1], "x", 1) == 1);
+        for (int i = 0; i < 2; i++) {
+            recv_set.clear();
+            CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+            BOOST_CHECK(recv_set.count(fds[0]));
+        }
+        pnode->fPauseRecv = true;
+        connman.UpdateSocketInterest(pnode.get());
+        recv_set.clear();
+        CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+        BOOST_CHECK(!recv_set.count(fds[0]));
+        pnode->fPauseRecv = false;
+        connman.UpdateSocketInterest(pnode.get());
+
+        // With data queued, the socket is waited on for sending instead
+        {
+            LOCK(pnode->cs_vSend);
+            pnode->vSendMsg.push_back(std::make_shared<const std::vector<unsigned char>>(1, 0));
+            connman.UpdateSocketInterest(pnode.get());
+        }
+        CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+        BOOST_CHECK(send_set.count(fds[0]));
+        {
+            LOCK(pnode->cs_vSend);
+            pnode->vSendMsg.clear();
+            connman.UpdateSocketInterest(pnode.get());
+        }
+        char c;
+        BOOST_REQUIRE(read(fds[0], &c, 1) == 1);
+
+        // A wakeup cuts the wait short
+#ifdef USE_EPOLL
+        recv_set.clear();
+        send_set.clear();
+        CConnmanTest::WakeSocketHandler(connman);
+        int64_t nStart = GetTimeMillis();
+        CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+        BOOST_CHECK(GetTimeMillis() - nStart < SOCKET_EVENTS_TIMEOUT);
+        BOOST_CHECK(recv_set.empty() && send_set.empty());
+#endif
+
+        // The peer closing the connection is reported
+        close(fds[1]);
+        recv_set.clear();
+        CConnmanTest::SocketEvents(connman, recv_set, send_set, error_set);
+        BOOST_CHECK(recv_set.count(fds[0]) || error_set.count(fds[0]));
+
+        CConnmanTest::ClearNodes(connman);
+    }
+}
+#endif
+
+/** Hands out numbered messages for a node, recording the order they are handled in */
+class OrderCheckingMsgProc : public NetEventsInterface
+{
+public:
+    std::mutex mutex;
+    std::deque<int> queued;
+    std::vector<int> handled;
+    std::atomic<bool> fOverlap{false};
+
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        Enter();
+        int n;
+        bool fMore;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued.empty()) {
+                Leave();
+                return false;
+            }
+            n = queued.front();
+            queued.pop_front();
+            fMore = !queued.empty();
+        }
+        // Give other handler threads the chance to pick up the node meanwhile
+        std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handled.push_back(n);
+        }
+        Leave();
+        return fMore;
+    }
+
+    bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        Enter();
+        std::this_thread::yield();
+        Leave();
+        return true;
+    }
+
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+
+private:
+    std::atomic<int> nBusy{0};
+
+    void Enter() { if (nBusy++ != 0) fOverlap = true; }
+    void Leave() { nBusy--; }
+};
+
+BOOST_AUTO_TEST_CASE(message_handler_threads)
+{
+    BOOST_CHECK_EQUAL(CConnman::Options().nMsgHandlerThreads, DEFAULT_MSG_HANDLER_THREADS);
+
+    const int nMessages = 1000;
+    OrderCheckingMsgProc msgproc;
+    for (int i = 0; i < nMessages; i++) {
+        msgproc.queued.push_back(i);
+    }
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CConnman connman(0x1337, 0x1337);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false);
+    CConnmanTest::AddNode(connman, node);
+
+    // All handler threads compete for the one node, which only one may handle at a time
+    CConnmanTest::StartMessageHandlers(connman, msgproc, DEFAULT_MSG_HANDLER_THREADS);
+    int64_t nStart = GetTimeMillis();
+    while (GetTimeMillis() - nStart < 10000) {
+        {
+            std::lock_guard<std::mutex> lock(msgproc.mutex);
+            if ((int)msgproc.handled.size() == nMessages) break;
+        }
+        MilliSleep(10);
+    }
+    CConnmanTest::StopMessageHandlers(connman);
+    CConnmanTest::ClearNodes(connman);
+
+    BOOST_CHECK(!msgproc.fOverlap);
+    std::vector<int> expected(nMessages);
+    std::iota(expected.begin(), expected.end(), 0);
+    BOOST_CHECK(msgproc.handled == expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
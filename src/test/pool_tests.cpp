@@ -0,0 +1,119 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/test_kusacoin.h>
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating)
+{
+    PoolResource<8, 8> resource(64);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 64U);
+
+    // Freed blocks are handed out again
+    void* block = resource.Allocate(8, 1);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 56U);
+    resource.Deallocate(block, 8, 1);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 64U);
+    BOOST_CHECK(resource.Allocate(8, 1) == block);
+
+    // The rest of the chunk is used before a new one is allocated
+    std::vector<void*> blocks;
+    for (int i = 0; i < 7; i++) {
+        blocks.push_back(resource.Allocate(8, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 0U);
+    blocks.push_back(resource.Allocate(8, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 56U);
+
+    // Blocks that are too large or too strictly aligned are not pooled
+    void* large = resource.Allocate(16, 8);
+    void* aligned = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    resource.Deallocate(large, 16, 8);
+    resource.Deallocate(aligned, 8, 16);
+
+    for (void* b : blocks) {
+        resource.Deallocate(b, 8, 8);
+    }
+    resource.Deallocate(block, 8, 1);
+}
+
+BOOST_AUTO_TEST_CASE(remaining_chunk_is_reused)
+{
+    // A 24 byte chunk fits one 16 byte block. The 8 bytes left over when
+    // the next chunk is started go to the free list for 8 byte blocks.
+    PoolResource<16, 8> resource(24);
+    void* first = resource.Allocate(16, 8);
+    void* second = resource.Allocate(16, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 8U + 8U);
+    void* leftover = resource.Allocate(8, 8);
+    BOOST_CHECK(leftover == static_cast<char*>(first) + 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    resource.Deallocate(first, 16, 8);
+    resource.Deallocate(second, 16, 8);
+    resource.Deallocate(leftover, 8, 8);
+}
+
+BOOST_AUTO_TEST_CASE(unordered_map_in_pool)
+{
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        PoolAllocator<std::pair<const uint64_t, uint64_t>, 64, alignof(void*)>> Map;
+    Map::allocator_type::ResourceType resource(1024);
+    Map map(0, Map::hasher(), Map::key_equal(), &resource);
+
+    for (uint64_t i = 0; i < 1000; i++) {
+        map[i] = i * 2;
+    }
+    BOOST_CHECK_GT(resource.NumAllocatedChunks(), 1U);
+    const size_t usage = memusage::DynamicUsage(map);
+    BOOST_CHECK_GE(usage, resource.NumAllocatedChunks() * resource.ChunkSizeBytes());
+
+    // Erased nodes go to the free list and are reused without new chunks.
+    // The pool keeps their memory, so they still count.
+    const size_t chunks = resource.NumAllocatedChunks();
+    for (uint64_t i = 0; i < 500; i++) {
+        map.erase(i);
+    }
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), usage);
+    for (uint64_t i = 1000; i < 1500; i++) {
+        map[i] = i * 2;
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    for (uint64_t i = 500; i < 1500; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i * 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coins_cache_memory)
+{
+    // Flushing returns the pool's memory
+    CCoinsView base;
+    CCoinsViewCache cache(&base);
+    const size_t empty_usage = cache.DynamicMemoryUsage();
+    CTxOut txout(1, CScript() << OP_1);
+    for (uint32_t i = 0; i < 10000; i++) {
+        cache.AddCoin(COutPoint(uint256(), i), Coin(txout, 1, false), false);
+    }
+    BOOST_CHECK_GT(cache.DynamicMemoryUsage(), empty_usage);
+    cache.Flush();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), empty_usage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
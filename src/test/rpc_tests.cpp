@@ -351,4 +351,26 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_FIXTURE_TEST_CASE(rpc_gettxoutsetinfo, TestChain100Setup)
+{
+    UniValue legacy = CallRPC("gettxoutsetinfo");
+    UniValue muhash = CallRPC("gettxoutsetinfo muhash");
+    UniValue none = CallRPC("gettxoutsetinfo none");
+    BOOST_CHECK_EQUAL(find_value(legacy.get_obj(), "transactions").get_int(), 100);
+    // The scan in txid ranges sees the same coins as the legacy one
+    for (const char* field : {"height", "bestblock", "transactions", "txouts", "bogosize", "total_amount"}) {
+        BOOST_CHECK_EQUAL(find_value(muhash.get_obj(), field).write(), find_value(legacy.get_obj(), field).write());
+        BOOST_CHECK_EQUAL(find_value(none.get_obj(), field).write(), find_value(legacy.get_obj(), field).write());
+    }
+    BOOST_CHECK(find_value(legacy.get_obj(), "hash_serialized_2").isStr());
+    BOOST_CHECK(find_value(muhash.get_obj(), "hash_serialized_2").isNull());
+    BOOST_CHECK(find_value(muhash.get_obj(), "muhash").isStr());
+    BOOST_CHECK(find_value(none.get_obj(), "muhash").isNull());
+    BOOST_CHECK_EQUAL(find_value(CallRPC("gettxoutsetinfo muhash").get_obj(), "muhash").get_str(), find_value(muhash.get_obj(), "muhash").get_str());
+
+    CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    BOOST_CHECK(find_value(CallRPC("gettxoutsetinfo muhash").get_obj(), "muhash").get_str() != find_value(muhash.get_obj(), "muhash").get_str());
+    BOOST_CHECK_THROW(CallRPC("gettxoutsetinfo sha256"), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
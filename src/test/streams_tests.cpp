@@ -69,6 +69,43 @@ BOOST_AUTO_TEST_CASE(streams_vector_writer)
     vch.clear();
 }
 
+BOOST_AUTO_TEST_CASE(streams_buffer_reader)
+{
+    unsigned char data[] = { 1, 255, 3, 4, 5, 6 };
+
+    CBufferReader reader(SER_NETWORK, INIT_PROTO_VERSION, data, data + sizeof(data));
+    BOOST_CHECK_EQUAL(reader.size(), 6U);
+    BOOST_CHECK(!reader.empty());
+
+    // Read a single byte as an unsigned char.
+    unsigned char a;
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(reader.size(), 5U);
+
+    // Read a single byte as a signed char.
+    signed char b;
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, -1);
+
+    // Read a 4 bytes as an unsigned int.
+    unsigned int c;
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 100992003U); // 3,4,5,6 in little-endian base-256
+    BOOST_CHECK(reader.empty());
+
+    // Reading past the end throws and leaves the reader as it was.
+    unsigned char d;
+    BOOST_CHECK_THROW(reader >> d, std::ios_base::failure);
+    BOOST_CHECK(reader.empty());
+
+    // The bytes are not copied, the reader sees changes to the buffer.
+    CBufferReader reader2(SER_NETWORK, INIT_PROTO_VERSION, data, data + sizeof(data));
+    data[0] = 7;
+    reader2 >> a;
+    BOOST_CHECK_EQUAL(a, 7);
+}
+
 BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
 {
     std::vector<char> in;
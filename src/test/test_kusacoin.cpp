@@ -9,6 +9,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -32,6 +33,60 @@ void CConnmanTest::ClearNodes()
     g_connman->vNodes.clear();
 }
 
+void CConnmanTest::AddNode(CConnman& connman, CNode& node)
+{
+    // As in AcceptConnection
+    connman.UpdateSocketInterest(&node);
+    LOCK(connman.cs_vNodes);
+    connman.vNodes.push_back(&node);
+}
+
+void CConnmanTest::ClearNodes(CConnman& connman)
+{
+    LOCK(connman.cs_vNodes);
+    connman.vNodes.clear();
+}
+
+bool CConnmanTest::InitSocketEvents(CConnman& connman, SocketEventsMode mode)
+{
+    // As in Start
+    connman.interruptNet.reset();
+    connman.socketEventsMode = mode;
+    return connman.InitSocketEvents();
+}
+
+void CConnmanTest::SocketEvents(CConnman& connman, std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    connman.SocketEvents(recv_set, send_set, error_set);
+}
+
+void CConnmanTest::WakeSocketHandler(CConnman& connman)
+{
+    connman.WakeSocketHandler();
+}
+
+void CConnmanTest::StartMessageHandlers(CConnman& connman, NetEventsInterface& msgproc, int nThreads)
+{
+    // As in Start
+    connman.m_msgproc = &msgproc;
+    connman.fMsgProcWake = false;
+    connman.flagInterruptMsgProc = false;
+    for (int i = 0; i < nThreads; i++)
+        connman.threadMessageHandlers.emplace_back(&CConnman::ThreadMessageHandler, &connman);
+}
+
+void CConnmanTest::StopMessageHandlers(CConnman& connman)
+{
+    {
+        std::lock_guard<std::mutex> lock(connman.mutexMsgProc);
+        connman.flagInterruptMsgProc = true;
+    }
+    connman.condMsgProc.notify_all();
+    for (std::thread& threadMessageHandler : connman.threadMessageHandlers)
+        threadMessageHandler.join();
+    connman.threadMessageHandlers.clear();
+}
+
 uint256 insecure_rand_seed = GetRandHash();
 FastRandomContext insecure_rand_ctx(insecure_rand_seed);
 
@@ -47,6 +102,7 @@ std::ostream& operator<<(std::ostream& os, const uint256& num)
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         SHA256AutoDetect();
+        lyra2re2_autodetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
@@ -97,6 +153,9 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i < nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadCoinsPrefetch);
+        threadGroup.create_thread(&ThreadBlockFileWriter);
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         peerLogic.reset(new PeerLogicValidation(connman, scheduler));
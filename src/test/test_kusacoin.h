@@ -9,6 +9,7 @@
 #include <chainparamsbase.h>
 #include <fs.h>
 #include <key.h>
+#include <net.h>
 #include <pubkey.h>
 #include <random.h>
 #include <scheduler.h>
@@ -56,6 +57,13 @@ class CNode;
 struct CConnmanTest {
     static void AddNode(CNode& node);
     static void ClearNodes();
+    static void AddNode(CConnman& connman, CNode& node);
+    static void ClearNodes(CConnman& connman);
+    static bool InitSocketEvents(CConnman& connman, SocketEventsMode mode);
+    static void SocketEvents(CConnman& connman, std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    static void WakeSocketHandler(CConnman& connman);
+    static void StartMessageHandlers(CConnman& connman, NetEventsInterface& msgproc, int nThreads);
+    static void StopMessageHandlers(CConnman& connman);
 };
 
 class PeerLogicValidation;
@@ -121,6 +129,9 @@ struct TestMemPoolEntryHelper
 
 CBlock getBlock13b8a();
 
+/** Clear a shutdown request, defined in test_kusacoin_main.cpp */
+void AbortShutdown();
+
 // define an implicit conversion here so that uint256 may be used directly in BOOST_CHECK_*
 std::ostream& operator<<(std::ostream& os, const uint256& num);
 
@@ -7,6 +7,7 @@
 
 #include <net.h>
 
+#include <atomic>
 #include <memory>
 
 #include <boost/test/unit_test.hpp>
@@ -18,12 +19,19 @@ std::unique_ptr<CConnman> g_connman;
   std::exit(EXIT_SUCCESS);
 }
 
-[[noreturn]] void StartShutdown()
+static std::atomic<bool> fRequestShutdown(false);
+
+void StartShutdown()
 {
-  std::exit(EXIT_SUCCESS);
+  fRequestShutdown = true;
+}
+
+void AbortShutdown()
+{
+  fRequestShutdown = false;
 }
 
 bool ShutdownRequested()
 {
-  return false;
+  return fRequestShutdown;
 }
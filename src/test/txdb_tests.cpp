@@ -0,0 +1,94 @@
+// Copyright (c) 2018 The Kusacoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <txdb.h>
+#include <uint256.h>
+#include <test/test_kusacoin.h>
+
+#include <map>
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+struct RegtestBasicSetup : public BasicTestingSetup {
+    RegtestBasicSetup() : BasicTestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, RegtestBasicSetup)
+
+//! Load the block index from blocktree into loaded, the way CChainState::LoadBlockIndex does
+static bool LoadIndex(CBlockTreeDB& blocktree, std::map<uint256, std::unique_ptr<CBlockIndex>>& loaded, bool fCheckHashes, int nCheckThreads)
+{
+    loaded.clear();
+    return blocktree.LoadBlockIndexGuts(Params().GetConsensus(), [&loaded](const uint256& hash) -> CBlockIndex* {
+        if (hash.IsNull())
+            return nullptr;
+        std::unique_ptr<CBlockIndex>& pindex = loaded[hash];
+        if (!pindex) {
+            pindex.reset(new CBlockIndex());
+            pindex->phashBlock = &loaded.find(hash)->first;
+        }
+        return pindex.get();
+    }, fCheckHashes, nCheckThreads);
+}
+
+BOOST_AUTO_TEST_CASE(load_block_index_guts)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    CBlockTreeDB blocktree(1 << 20, true);
+
+    // A chain of index entries satisfying the regtest proof of work
+    std::vector<uint256> hashes(300);
+    std::vector<CBlockIndex> entries(hashes.size());
+    std::vector<const CBlockIndex*> blockinfo;
+    for (size_t i = 0; i < entries.size(); i++) {
+        CBlockIndex& index = entries[i];
+        index.pprev = i ? &entries[i - 1] : nullptr;
+        index.nHeight = i;
+        index.nTime = 1531062002 + i;
+        index.nBits = 0x207fffff;
+        while (!CheckProofOfWork(hashes[i] = index.GetBlockHeader().GetHash(), index.nBits, params))
+            index.nNonce++;
+        index.phashBlock = &hashes[i];
+        blockinfo.push_back(&index);
+    }
+    BOOST_CHECK(blocktree.WriteBatchSync({}, 0, blockinfo));
+
+    std::map<uint256, std::unique_ptr<CBlockIndex>> loaded;
+    for (int nCheckThreads : {0, 4}) {
+        for (bool fCheckHashes : {false, true}) {
+            BOOST_CHECK(LoadIndex(blocktree, loaded, fCheckHashes, nCheckThreads));
+            BOOST_CHECK_EQUAL(loaded.size(), entries.size());
+            for (size_t i = 0; i < entries.size(); i++) {
+                const CBlockIndex* pindex = loaded.at(hashes[i]).get();
+                BOOST_CHECK_EQUAL(pindex->nHeight, entries[i].nHeight);
+                BOOST_CHECK(pindex->GetBlockHeader().GetHash() == hashes[i]);
+            }
+        }
+    }
+
+    // An entry stored under a key that is not its hash (but that meets the
+    // proof of work) is only caught when hashes are checked
+    uint256 wrong_hash = uint256S("0x01");
+    CBlockIndex wrong_entry = entries.back();
+    wrong_entry.phashBlock = &wrong_hash;
+    BOOST_CHECK(blocktree.WriteBatchSync({}, 0, {&wrong_entry}));
+    for (int nCheckThreads : {0, 4}) {
+        BOOST_CHECK(LoadIndex(blocktree, loaded, false, nCheckThreads));
+        BOOST_CHECK(!LoadIndex(blocktree, loaded, true, nCheckThreads));
+    }
+
+    // An entry whose key does not meet its nBits always fails
+    uint256 high_hash = uint256S("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    wrong_entry.phashBlock = &high_hash;
+    BOOST_CHECK(blocktree.WriteBatchSync({}, 0, {&wrong_entry}));
+    for (int nCheckThreads : {0, 4}) {
+        BOOST_CHECK(!LoadIndex(blocktree, loaded, false, nCheckThreads));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
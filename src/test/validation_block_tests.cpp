@@ -8,10 +8,15 @@
 #include <chainparams.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
+#include <init.h>
+#include <key.h>
 #include <miner.h>
 #include <pow.h>
 #include <random.h>
+#include <script/interpreter.h>
 #include <test/test_kusacoin.h>
+#include <txdb.h>
+#include <util.h>
 #include <validation.h>
 #include <validationinterface.h>
 
@@ -184,4 +189,245 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+static CMutableTransaction SpendFirstOutput(const CTransaction& prev, const CKey& key)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prev.GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = prev.vout[0].nValue - 10000;
+    tx.vout[0].scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(prev.vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+BOOST_FIXTURE_TEST_CASE(prefetch_block_coins, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Start with an empty coins cache, so the spent coinbase is only in the database.
+    // The child spends an output of the same block, which is not looked up.
+    {
+        LOCK(cs_main);
+        pcoinsTip->Flush();
+    }
+    CMutableTransaction spend = SpendFirstOutput(coinbaseTxns[0], coinbaseKey);
+    CMutableTransaction child = SpendFirstOutput(spend, coinbaseKey);
+    CoinsPrefetchStats before = GetCoinsPrefetchStats();
+    CBlock block = CreateAndProcessBlock({spend, child}, scriptPubKey);
+    CoinsPrefetchStats after = GetCoinsPrefetchStats();
+    BOOST_CHECK_EQUAL(chainActive.Tip()->GetBlockHash(), block.GetHash());
+    BOOST_CHECK_EQUAL(after.nBlocks - before.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(after.nMisses - before.nMisses, 1U);
+    BOOST_CHECK_EQUAL(after.nHits - before.nHits, 0U);
+    BOOST_CHECK_EQUAL(after.nNotFound - before.nNotFound, 0U);
+
+    // The output of the child was added to the cache when the block was connected
+    before = after;
+    block = CreateAndProcessBlock({SpendFirstOutput(child, coinbaseKey)}, scriptPubKey);
+    after = GetCoinsPrefetchStats();
+    BOOST_CHECK_EQUAL(chainActive.Tip()->GetBlockHash(), block.GetHash());
+    BOOST_CHECK_EQUAL(after.nBlocks - before.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(after.nMisses - before.nMisses, 0U);
+    BOOST_CHECK_EQUAL(after.nHits - before.nHits, 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_file_writer, TestChain100Setup)
+{
+    // Blocks and undo data written on the writer thread can be read back
+    // right away, also when every write has to wait for the one before it
+    const size_t nOldQueueSize = nBlockWriteQueueSize;
+    for (size_t nQueueSize : {(size_t)1, nOldQueueSize}) {
+        nBlockWriteQueueSize = nQueueSize;
+        BlockFileWriterStats before = GetBlockFileWriterStats();
+        for (int i = 0; i < 5; i++) {
+            CBlock block = CreateAndProcessBlock({}, CScript() << OP_TRUE);
+            CBlock read;
+            BOOST_CHECK(ReadBlockFromDisk(read, chainActive.Tip(), Params().GetConsensus()));
+            BOOST_CHECK_EQUAL(read.GetHash(), block.GetHash());
+        }
+        BOOST_CHECK(CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), 3, 5));
+        // The block and undo data of each block went through the queue
+        BlockFileWriterStats after = GetBlockFileWriterStats();
+        BOOST_CHECK(after.nQueued >= before.nQueued + 10);
+        BOOST_CHECK_EQUAL(after.nFailed, before.nFailed);
+    }
+    nBlockWriteQueueSize = nOldQueueSize;
+
+    BOOST_CHECK(FlushStateToDisk());
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip()->nStatus & BLOCK_HAVE_UNDO);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_file_writer_failure, TestChain100Setup)
+{
+    // A block that fails to be written keeps the block index from being
+    // written, as its entry would refer to data that is not on disk
+    BOOST_CHECK(FlushStateToDisk());
+    const fs::path path = GetBlockPosFilename(CDiskBlockPos(0, 0), "blk");
+    const fs::path moved = path.string() + ".moved";
+    fs::rename(path, moved);
+    // Opening a directory as the block file fails, even for root
+    fs::create_directory(path);
+
+    BlockFileWriterStats before = GetBlockFileWriterStats();
+    CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    BOOST_CHECK(!FlushStateToDisk());
+    BlockFileWriterStats after = GetBlockFileWriterStats();
+    BOOST_CHECK_EQUAL(after.nFailed, before.nFailed + 1);
+    BOOST_CHECK(after.nQueued > before.nQueued);
+    BOOST_CHECK(ShutdownRequested());
+
+    // The failure sticks, also once writes work again
+    fs::remove(path);
+    fs::rename(moved, path);
+    BOOST_CHECK(!FlushStateToDisk());
+    AbortShutdown();
+}
+
+BOOST_FIXTURE_TEST_CASE(read_block_mapped, TestChain100Setup)
+{
+    // Blocks read through a mapping of their file match the ones read with stdio,
+    // also blocks appended after the file was mapped
+    const unsigned int nOldMapFiles = nBlockMapFiles;
+    nBlockMapFiles = 2;
+    for (int i = 0; i < 3; i++) {
+        for (const CBlockIndex* pindex = chainActive.Tip(); pindex; pindex = pindex->pprev) {
+            CBlock mapped;
+            BOOST_CHECK(ReadBlockFromDisk(mapped, pindex, Params().GetConsensus()));
+            BOOST_CHECK_EQUAL(mapped.GetHash(), pindex->GetBlockHash());
+            nBlockMapFiles = 0;
+            CBlock read;
+            BOOST_CHECK(ReadBlockFromDisk(read, pindex, Params().GetConsensus()));
+            nBlockMapFiles = 2;
+            BOOST_CHECK(SerializeHash(mapped) == SerializeHash(read));
+        }
+        CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    }
+    nBlockMapFiles = nOldMapFiles;
+}
+
+BOOST_FIXTURE_TEST_CASE(read_raw_block, TestChain100Setup)
+{
+    // The bytes on disk are the witness serialization of the block that is sent to peers
+    const unsigned int nOldMapFiles = nBlockMapFiles;
+    for (unsigned int nMapFiles : {0U, 2U}) {
+        nBlockMapFiles = nMapFiles;
+        for (const CBlockIndex* pindex = chainActive.Tip(); pindex; pindex = pindex->pprev) {
+            CBlock block;
+            BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+            std::vector<uint8_t> expected;
+            CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, expected, 0, block);
+
+            std::vector<uint8_t> raw;
+            BOOST_CHECK(ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+            BOOST_CHECK(raw == expected);
+        }
+
+        // A wrong message start is caught
+        std::vector<uint8_t> raw;
+        const CMessageHeader::MessageStartChars wrong_start = {0, 0, 0, 0};
+        BOOST_CHECK(!ReadRawBlockFromDisk(raw, chainActive.Tip(), wrong_start));
+    }
+    nBlockMapFiles = nOldMapFiles;
+}
+
+static std::map<COutPoint, Coin> ReadCoinsDB()
+{
+    std::map<COutPoint, Coin> coins;
+    FlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        Coin coin;
+        BOOST_REQUIRE(pcursor->GetKey(key) && pcursor->GetValue(coin));
+        coins.emplace(key, std::move(coin));
+    }
+    return coins;
+}
+
+static bool SameCoins(const std::map<COutPoint, Coin>& a, const std::map<COutPoint, Coin>& b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const std::pair<const COutPoint, Coin>& x, const std::pair<const COutPoint, Coin>& y) {
+        return x.first == y.first && x.second.out == y.second.out && x.second.nHeight == y.second.nHeight && x.second.fCoinBase == y.second.fCoinBase;
+    });
+}
+
+BOOST_FIXTURE_TEST_CASE(utxo_snapshot, TestChain100Setup)
+{
+    CBlockIndex* pindexBase = chainActive.Tip();
+    const std::map<COutPoint, Coin> coins = ReadCoinsDB();
+    const fs::path path = GetDataDir() / "utxo.dat";
+    UTXOSnapshotInfo info;
+    std::string strError;
+    BOOST_REQUIRE(DumpUTXOSnapshot(path, info, strError));
+    BOOST_CHECK_EQUAL(info.hashBlock, pindexBase->GetBlockHash());
+    BOOST_CHECK_EQUAL(info.nHeight, 100);
+    BOOST_CHECK_EQUAL(info.nCoins, coins.size());
+    BOOST_CHECK(!DumpUTXOSnapshot(path, info, strError));
+
+    // Only snapshots the chain parameters commit to are loaded
+    UTXOSnapshotInfo info_rejected;
+    BOOST_CHECK(!LoadUTXOSnapshot(Params(), path, info_rejected, strError));
+    BOOST_CHECK(strError.find("Unknown UTXO snapshot") == 0);
+    UpdateUTXOSnapshot(info.hashBlock, uint256());
+    BOOST_CHECK(!LoadUTXOSnapshot(Params(), path, info_rejected, strError));
+    BOOST_CHECK(strError.find("UTXO snapshot hash mismatch") == 0);
+    UpdateUTXOSnapshot(info.hashBlock, info.hashFile);
+
+    // The snapshot has to extend the active chain
+    BOOST_CHECK(!LoadUTXOSnapshot(Params(), path, info_rejected, strError));
+    BOOST_CHECK(strError.find("does not extend") != std::string::npos);
+
+    // Go back to block 90 without activating the best chain again
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, Params(), chainActive[91]));
+        BOOST_CHECK(ResetBlockFailureFlags(pindexBase->GetAncestor(91)));
+    }
+    BOOST_CHECK_EQUAL(chainActive.Height(), 90);
+    BOOST_CHECK(!SameCoins(ReadCoinsDB(), coins));
+
+    UTXOSnapshotInfo info_loaded;
+    BOOST_REQUIRE(LoadUTXOSnapshot(Params(), path, info_loaded, strError));
+    BOOST_CHECK_EQUAL(info_loaded.hashBlock, info.hashBlock);
+    BOOST_CHECK_EQUAL(info_loaded.nCoins, info.nCoins);
+    BOOST_CHECK_EQUAL(info_loaded.hashFile, info.hashFile);
+    BOOST_CHECK_EQUAL(chainActive.Tip(), pindexBase);
+    BOOST_CHECK(SameCoins(ReadCoinsDB(), coins));
+    // Only the blocks skipped over are assumed valid
+    BOOST_CHECK(!(chainActive[90]->nStatus & BLOCK_ASSUMED_VALID));
+    for (int nHeight = 91; nHeight <= 100; nHeight++) {
+        BOOST_CHECK(chainActive[nHeight]->nStatus & BLOCK_ASSUMED_VALID);
+    }
+
+    // The chain continues from the snapshot
+    CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 101);
+    BOOST_CHECK(chainActive.Tip()->IsValid(BLOCK_VALID_SCRIPTS));
+    BOOST_CHECK(!(chainActive.Tip()->nStatus & BLOCK_ASSUMED_VALID));
+    // Checking the chain at startup stops at the blocks without undo data
+    BOOST_CHECK(CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), 4, 20));
+
+    // A damaged snapshot is rejected before anything is changed
+    const fs::path path_bad = GetDataDir() / "utxo_bad.dat";
+    fs::copy_file(path, path_bad);
+    FILE* file = fsbridge::fopen(path_bad, "r+b");
+    BOOST_REQUIRE(file);
+    fseek(file, 100, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, 100, SEEK_SET);
+    fputc(c ^ 1, file);
+    fclose(file);
+    BOOST_CHECK(!LoadUTXOSnapshot(Params(), path_bad, info, strError));
+    BOOST_CHECK(strError.find("Invalid UTXO snapshot") == 0);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 101);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
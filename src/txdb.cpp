@@ -6,6 +6,7 @@
 #include <txdb.h>
 
 #include <chainparams.h>
+#include <checkqueue.h>
 #include <hash.h>
 #include <random.h>
 #include <pow.h>
@@ -30,6 +31,9 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+//! Number of block index entries handed to the check workers at once
+static const size_t BLOCK_INDEX_CHECK_BATCH = 1024;
+
 namespace {
 
 struct CoinEntry {
@@ -54,7 +58,18 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CDBOptions GetDBOptions(const std::string& name, size_t nCacheSize)
+{
+    CDBOptions options(nCacheSize);
+    options.nWriteBufferSize = std::max<int64_t>(0, gArgs.GetArg("-" + name + "writebuffer", options.nWriteBufferSize >> 20)) << 20;
+    options.nBlockSize = std::max<int64_t>(1, gArgs.GetArg("-" + name + "blocksize", options.nBlockSize >> 10)) << 10;
+    options.nMaxFileSize = std::max<int64_t>(1, gArgs.GetArg("-" + name + "filesize", options.nMaxFileSize >> 20)) << 20;
+    options.nMaxOpenFiles = gArgs.GetArg("-" + name + "maxopenfiles", options.nMaxOpenFiles);
+    options.nBloomBitsPerKey = std::max<int64_t>(0, gArgs.GetArg("-" + name + "bloombits", options.nBloomBitsPerKey));
+    return options;
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", GetDBOptions("chainstate", nCacheSize), fMemory, fWipe, true)
 {
 }
 
@@ -81,13 +96,14 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
+    nWrites++;
 
     uint256 old_tip = GetBestBlock();
     if (old_tip.IsNull()) {
@@ -117,7 +133,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
         count++;
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            mapCoins.erase(itOld);
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -142,12 +160,61 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::ReplaceCoins(const uint256 &hashBlock, const std::function<bool(COutPoint&, Coin&)> &next)
+{
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    assert(!hashBlock.IsNull());
+    nWrites++;
+
+    // The old coins are gone after the first partial batch, so only a replay
+    // of all blocks can bring the database to hashBlock again.
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, uint256()});
+    if (!db.WriteBatch(batch))
+        return false;
+    batch.Clear();
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    COutPoint outpoint;
+    for (pcursor->Seek(DB_COIN); pcursor->Valid(); pcursor->Next()) {
+        CoinEntry entry(&outpoint);
+        if (!pcursor->GetKey(entry) || entry.key != DB_COIN)
+            break;
+        batch.Erase(entry);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+
+    Coin coin;
+    while (next(outpoint, coin)) {
+        batch.Write(CoinEntry(&outpoint), coin);
+        count++;
+        if (batch.SizeEstimate() > batch_size) {
+            LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    bool ret = db.WriteBatch(batch, true);
+    LogPrint(BCLog::COINDB, "Replaced the coin database with %u transaction outputs\n", (unsigned int)count);
+    return ret;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", ::GetDBOptions("blockindex", nCacheSize), fMemory, fWipe) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -171,12 +238,17 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
+{
+    return Cursor(uint256());
+}
+
+CCoinsViewCursor *CCoinsViewDB::Cursor(const uint256 &hashStart) const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    i->pcursor->Seek(std::make_pair(DB_COIN, hashStart));
     // Cache key of first record
     if (i->pcursor->Valid()) {
         CoinEntry entry(&i->keyTmp.second);
@@ -259,12 +331,83 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+namespace {
+
+/** Closure representing the checks of one block index entry, for CCheckQueue. */
+class CBlockIndexCheck
+{
+private:
+    const Consensus::Params* consensusParams;
+    CBlockHeader header;
+    uint256 hash;
+    bool fCheckHash;
+
+public:
+    CBlockIndexCheck() : consensusParams(nullptr), fCheckHash(false) {}
+    CBlockIndexCheck(const Consensus::Params& consensusParamsIn, const CBlockHeader& headerIn, const uint256& hashIn, bool fCheckHashIn) :
+        consensusParams(&consensusParamsIn), header(headerIn), hash(hashIn), fCheckHash(fCheckHashIn) {}
+
+    bool operator()()
+    {
+        // Entries are keyed by their block hash, so recomputing it is only a consistency check
+        if (fCheckHash && header.GetHash() != hash)
+            return error("LoadBlockIndexGuts: block index entry does not match its key: %s", hash.ToString());
+        if (!CheckProofOfWork(hash, header.nBits, *consensusParams))
+            return error("LoadBlockIndexGuts: CheckProofOfWork failed: %s", hash.ToString());
+        return true;
+    }
+
+    void swap(CBlockIndexCheck& check)
+    {
+        std::swap(consensusParams, check.consensusParams);
+        std::swap(header, check.header);
+        std::swap(hash, check.hash);
+        std::swap(fCheckHash, check.fCheckHash);
+    }
+};
+
+/** Worker threads of a CCheckQueue that only lives for the duration of one function. */
+class CScopedCheckThreads
+{
+private:
+    boost::thread_group threads;
+
+public:
+    template <typename T>
+    CScopedCheckThreads(CCheckQueue<T>& queue, int nThreads, const char* name)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threads.create_thread([&queue, name] { RenameThread(name); queue.Thread(); });
+        }
+    }
+
+    ~CScopedCheckThreads()
+    {
+        // Idle workers wait on a condition variable, which is an interruption point
+        threads.interrupt_all();
+        threads.join_all();
+    }
+};
+
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool fCheckHashes, int nCheckThreads)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
+    // The cursor is walked and mapBlockIndex filled on this thread, while the
+    // checks of the entries run on nCheckThreads workers. Without rehashing,
+    // a check is cheaper than handing it to a worker, so it runs inline.
+    CCheckQueue<CBlockIndexCheck> queue(128);
+    std::unique_ptr<CScopedCheckThreads> workers;
+    if (fCheckHashes && nCheckThreads > 1)
+        workers.reset(new CScopedCheckThreads(queue, nCheckThreads - 1, "kusacoin-loadidx"));
+    CCheckQueueControl<CBlockIndexCheck> control(workers ? &queue : nullptr);
+    std::vector<CBlockIndexCheck> vChecks;
+    vChecks.reserve(BLOCK_INDEX_CHECK_BATCH);
+
     // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -273,7 +416,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
                 // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+                CBlockIndex* pindexNew = insertBlockIndex(key.second);
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
                 pindexNew->nHeight        = diskindex.nHeight;
                 pindexNew->nFile          = diskindex.nFile;
@@ -287,8 +430,15 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                if (workers) {
+                    vChecks.emplace_back(consensusParams, pindexNew->GetBlockHeader(), key.second, fCheckHashes);
+                    if (vChecks.size() == BLOCK_INDEX_CHECK_BATCH) {
+                        control.Add(vChecks);
+                        vChecks.clear();
+                    }
+                } else if (!CBlockIndexCheck(consensusParams, pindexNew->GetBlockHeader(), key.second, fCheckHashes)()) {
+                    return false;
+                }
 
                 pcursor->Next();
             } else {
@@ -299,7 +449,8 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         }
     }
 
-    return true;
+    control.Add(vChecks);
+    return control.Wait();
 }
 
 namespace {
@@ -11,6 +11,8 @@
 #include <dbwrapper.h>
 #include <chain.h>
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -31,6 +33,10 @@ static const int64_t nDefaultDbBatchSize = 16 << 20;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
+//! -dbcachekeep default (percent)
+static const int nDefaultDbCacheKeep = 0;
+//! max. -dbcachekeep (percent), below the level at which the cache is written out again
+static const int nMaxDbCacheKeep = 80;
 //! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
 static const int64_t nMaxBlockDBCache = 2;
 //! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
@@ -40,6 +46,13 @@ static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
+/**
+ * The LevelDB tuning of the "chainstate" or "blockindex" database, from the
+ * -<name>writebuffer, -<name>blocksize, -<name>filesize, -<name>maxopenfiles
+ * and -<name>bloombits options.
+ */
+CDBOptions GetDBOptions(const std::string& name, size_t nCacheSize);
+
 struct CDiskTxPos : public CDiskBlockPos
 {
     unsigned int nTxOffset; // after header
@@ -70,6 +83,8 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Number of BatchWrite calls so far
+    std::atomic<uint64_t> nWrites{0};
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -77,12 +92,28 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Get a cursor that starts at the first coin with a txid of at least hashStart (in byte order)
+    CCoinsViewCursor *Cursor(const uint256 &hashStart) const;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    /**
+     * Replace all coins with the ones returned by next, until it returns
+     * false, as the UTXO set after hashBlock. The coins are written in
+     * partial batches. If this is interrupted, the blocks up to hashBlock are
+     * replayed from the genesis block at startup.
+     */
+    bool ReplaceCoins(const uint256 &hashBlock, const std::function<bool(COutPoint&, Coin&)> &next);
+
+    //! Number of writes started so far. Coins read in between two calls that
+    //! return the same number all belong to the same state of the database.
+    uint64_t GetWriteCount() const { return nWrites; }
+
+    CDBWrapper& GetDB() { return db; }
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -125,7 +156,13 @@ public:
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load all block index entries. Unless fCheckHashes is set, the database key is
+     * trusted to be the hash of the stored header, so no header needs to be rehashed;
+     * the claimed hash is still checked against the entry's nBits. With fCheckHashes,
+     * these checks are spread over nCheckThreads threads (including the calling one).
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool fCheckHashes, int nCheckThreads);
 };
 
 #endif // KUSACOIN_TXDB_H
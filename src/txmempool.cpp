@@ -310,6 +310,98 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
     }
 }
 
+void CTxMemPool::RemoveStagedForBlock(const setEntries &stage)
+{
+    AssertLockHeld(cs);
+    struct StateDelta {
+        int64_t nSize = 0;
+        CAmount nFee = 0;
+        int64_t nCount = 0;
+        int64_t nSigOpCost = 0;
+    };
+
+    // Every entry that descends from a removed one. Only its removed
+    // ancestors change, and these are reached through descendants only.
+    setEntries setAffected;
+    for (txiter removeIt : stage) {
+        CalculateDescendants(removeIt, setAffected);
+    }
+    for (txiter updateIt : setAffected) {
+        if (stage.count(updateIt)) continue;
+        StateDelta delta;
+        setEntries setVisited;
+        std::vector<txiter> vToVisit{updateIt};
+        while (!vToVisit.empty()) {
+            txiter it = vToVisit.back();
+            vToVisit.pop_back();
+            for (txiter parentIt : GetMemPoolParents(it)) {
+                if (!setAffected.count(parentIt) || !setVisited.insert(parentIt).second) continue;
+                if (stage.count(parentIt)) {
+                    delta.nSize -= parentIt->GetTxSize();
+                    delta.nFee -= parentIt->GetModifiedFee();
+                    delta.nCount--;
+                    delta.nSigOpCost -= parentIt->GetSigOpCost();
+                }
+                vToVisit.push_back(parentIt);
+            }
+        }
+        mapTx.modify(updateIt, update_ancestor_state(delta.nSize, delta.nFee, delta.nCount, delta.nSigOpCost));
+    }
+
+    // Every entry that stays and has a removed descendant. When a block is
+    // connected there are none, as parents of its transactions are confirmed
+    // by the same block. Its removed descendants are reached through the
+    // ancestors of the removed entries only.
+    setEntries setAncestors;
+    std::vector<txiter> vToVisit(stage.begin(), stage.end());
+    while (!vToVisit.empty()) {
+        txiter it = vToVisit.back();
+        vToVisit.pop_back();
+        for (txiter parentIt : GetMemPoolParents(it)) {
+            if (!stage.count(parentIt) && setAncestors.insert(parentIt).second) {
+                vToVisit.push_back(parentIt);
+            }
+        }
+    }
+    for (txiter updateIt : setAncestors) {
+        StateDelta delta;
+        setEntries setVisited;
+        std::vector<txiter> vToVisit{updateIt};
+        while (!vToVisit.empty()) {
+            txiter it = vToVisit.back();
+            vToVisit.pop_back();
+            for (txiter childIt : GetMemPoolChildren(it)) {
+                if (!setVisited.insert(childIt).second) continue;
+                if (stage.count(childIt)) {
+                    delta.nSize -= childIt->GetTxSize();
+                    delta.nFee -= childIt->GetModifiedFee();
+                    delta.nCount--;
+                    vToVisit.push_back(childIt);
+                } else if (setAncestors.count(childIt)) {
+                    vToVisit.push_back(childIt);
+                }
+            }
+        }
+        mapTx.modify(updateIt, update_descendant_state(delta.nSize, delta.nFee, delta.nCount));
+    }
+
+    // Sever the links with the entries that stay. Links between removed
+    // entries go away with them.
+    for (txiter removeIt : stage) {
+        const setEntries setParents = GetMemPoolParents(removeIt);
+        for (txiter parentIt : setParents) {
+            if (!stage.count(parentIt)) UpdateChild(parentIt, removeIt, false);
+        }
+        const setEntries setChildren = GetMemPoolChildren(removeIt);
+        for (txiter childIt : setChildren) {
+            if (!stage.count(childIt)) UpdateParent(childIt, removeIt, false);
+        }
+    }
+    for (txiter removeIt : stage) {
+        removeUnchecked(removeIt, MemPoolRemovalReason::BLOCK);
+    }
+}
+
 void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
 {
     nSizeWithDescendants += modifySize;
@@ -575,14 +667,13 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    setEntries stage;
+    for (const CTxMemPoolEntry* entry : entries) {
+        stage.insert(mapTx.iterator_to(*entry));
+    }
+    RemoveStagedForBlock(stage);
     for (const auto& tx : vtx)
     {
-        txiter it = mapTx.find(tx->GetHash());
-        if (it != mapTx.end()) {
-            setEntries stage;
-            stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
-        }
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
@@ -685,6 +685,11 @@ private:
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry);
+    /** Remove transactions confirmed in a block, with the same effect as
+     *  RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK). The ancestor
+     *  and descendant state of the entries that stay is updated once per
+     *  entry for the whole set, rather than once per removed transaction. */
+    void RemoveStagedForBlock(const setEntries &stage);
 
     /** Before calling removeUnchecked for a given transaction,
      *  UpdateForRemoveFromMempool must be called on the entire (dependent) set
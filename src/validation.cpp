@@ -15,6 +15,7 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <cuckoocache.h>
 #include <hash.h>
 #include <init.h>
@@ -42,6 +43,7 @@
 #include <warnings.h>
 
 #include <future>
+#include <list>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -161,7 +163,7 @@ public:
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
 
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
+    bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
 
     // Block (dis)connection on a given view:
@@ -178,6 +180,7 @@ public:
     bool ResetBlockFailureFlags(CBlockIndex *pindex);
 
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
+    void SetSnapshotTip(const CChainParams& params, CBlockIndex* pindex);
     bool RewindBlockIndex(const CChainParams& params);
     bool LoadGenesisBlock(const CChainParams& chainparams);
 
@@ -189,7 +192,7 @@ private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool);
 
-    CBlockIndex* AddToBlockIndex(const CBlockHeader& block);
+    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash);
     /** Create a new block index entry for a given block hash */
     CBlockIndex * InsertBlockIndex(const uint256& hash);
     void CheckBlockIndex(const Consensus::Params& consensusParams);
@@ -221,8 +224,13 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
+bool fCheckBlockIndexHashes = DEFAULT_CHECKBLOCKINDEXHASHES;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fPrefetchCoins = DEFAULT_PREFETCH_COINS;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nCoinCacheKeepUsage = 0;
+size_t nBlockWriteQueueSize = (size_t)DEFAULT_BLOCK_WRITE_QUEUE << 20;
+unsigned int nBlockMapFiles = DEFAULT_BLOCK_MMAP_FILES;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -1004,6 +1012,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, fMemPoolOnly);
 }
 
+/** Wait until the queued write of the block (or undo data) at pos is done */
+static void WaitForBlockFileData(bool fUndo, const CDiskBlockPos& pos);
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1024,6 +1035,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
+                WaitForBlockFileData(false, postx);
                 CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
                 if (file.IsNull())
                     return error("%s: OpenBlockFile failed", __func__);
@@ -1098,30 +1110,122 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+/**
+ * Memory mappings of the most recently read block files, so that reading a
+ * block does not open, seek and read the file. A mapping covers the file as
+ * it was when it was mapped; a block behind its end has the file mapped again.
+ */
+class CBlockFileMaps
 {
-    block.SetNull();
+private:
+    CCriticalSection cs;
+    //! Most recently used first, keyed by path so that a changed datadir does not match
+    std::list<std::pair<fs::path, std::shared_ptr<const fsbridge::MappedFile>>> listMaps;
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+public:
+    /** Get a mapping of the block file at pos that holds at least nEnd bytes, or nullptr */
+    std::shared_ptr<const fsbridge::MappedFile> Get(const CDiskBlockPos& pos, size_t nEnd)
+    {
+        const fs::path path = GetBlockPosFilename(pos, "blk");
+        LOCK(cs);
+        for (auto it = listMaps.begin(); it != listMaps.end(); ++it) {
+            if (it->first == path) {
+                if (it->second->size() < nEnd) {
+                    listMaps.erase(it);
+                    break;
+                }
+                listMaps.splice(listMaps.begin(), listMaps, it);
+                return it->second;
+            }
+        }
+        auto map = std::make_shared<const fsbridge::MappedFile>(path);
+        if (map->IsNull() || map->size() < nEnd) {
+            return nullptr;
+        }
+        listMaps.emplace_front(path, map);
+        while (listMaps.size() > nBlockMapFiles) {
+            listMaps.pop_back();
+        }
+        return map;
+    }
+
+    /** Drop the mapping of a block file, e.g. before it is deleted */
+    void Remove(int nFile)
+    {
+        const fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+        LOCK(cs);
+        listMaps.remove_if([&path](const std::pair<fs::path, std::shared_ptr<const fsbridge::MappedFile>>& entry) { return entry.first == path; });
+    }
+};
+
+static CBlockFileMaps blockfilemaps;
+
+/** Get a mapping of the file holding the block at pos and the block's size, or nullptr if the file can't be mapped. */
+static std::shared_ptr<const fsbridge::MappedFile> MapBlock(const CDiskBlockPos& pos, unsigned int& nSize)
+{
+    // The block follows the message start and its size
+    if (nBlockMapFiles == 0 || pos.nPos < 8) {
+        return nullptr;
+    }
+    auto map = blockfilemaps.Get(pos, pos.nPos);
+    if (!map) {
+        return nullptr;
+    }
+    nSize = ReadLE32(map->begin() + pos.nPos - 4);
+    if (map->size() - pos.nPos < nSize) {
+        map = blockfilemaps.Get(pos, (size_t)pos.nPos + nSize);
+    }
+    return map;
+}
+
+/** Deserialize the block at pos straight from a mapping of its file. Returns false if the file can't be mapped. */
+static bool ReadBlockFromMappedFile(CBlock& block, const CDiskBlockPos& pos)
+{
+    unsigned int nSize;
+    auto map = MapBlock(pos, nSize);
+    if (!map) {
+        return false;
+    }
+    CBufferReader reader(SER_DISK, CLIENT_VERSION, map->begin() + pos.nPos, map->begin() + pos.nPos + nSize);
+    reader >> block;
+    return true;
+}
+
+/** Read a block and check its proof of work, returning the hash that was checked. */
+static bool ReadBlockFromDisk(CBlock& block, uint256& hash, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    block.SetNull();
+    WaitForBlockFileData(false, pos);
 
     // Read block
     try {
-        filein >> block;
+        if (!ReadBlockFromMappedFile(block, pos)) {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    hash = block.GetHash();
+    if (!CheckProofOfWork(hash, block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    uint256 hash;
+    return ReadBlockFromDisk(block, hash, pos, consensusParams);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
@@ -1130,14 +1234,67 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    // Reuse the hash the proof of work was checked with, hashing is the expensive part of the read
+    uint256 hash;
+    if (!ReadBlockFromDisk(block, hash, blockPos, consensusParams))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
+    if (hash != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    block.clear();
+    WaitForBlockFileData(false, pos);
+
+    if (pos.nPos < 8)
+        return error("%s: no message start in front of the block at %s", __func__, pos.ToString());
+
+    unsigned int nSize;
+    auto map = MapBlock(pos, nSize);
+    if (map) {
+        const unsigned char* pblock = map->begin() + pos.nPos;
+        if (memcmp(pblock - 8, message_start, CMessageHeader::MESSAGE_START_SIZE))
+            return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+        block.assign(pblock, pblock + nSize);
+        return true;
+    }
+
+    // Open history file at the message start to read
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        filein >> FLATDATA(blk_start) >> nSize;
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE))
+            return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+        if (nSize > MAX_SIZE)
+            return error("%s: Block data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+        block.resize(nSize);
+        filein.read((char*)block.data(), nSize);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+    return ReadRawBlockFromDisk(block, blockPos, message_start);
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1474,6 +1631,7 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
+    WaitForBlockFileData(true, pos);
 
     // Open history file to read
     CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
@@ -1519,6 +1677,228 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // namespace
 
+static void CommitBlockFiles(int nFile, bool fFinalize, unsigned int nBlockFileSize, unsigned int nUndoFileSize);
+
+/**
+ * Appends blocks and undo data to the block files on a separate thread, so
+ * that validation does not wait for the disk. The jobs run in the order in
+ * which they were queued, so a flush of the files comes after the writes
+ * queued before it. Reads of data that is still queued wait for it.
+ *
+ * Without the thread, or after it stopped, jobs run on the calling thread.
+ *
+ * A failed write aborts the node. It is also remembered, and Wait reports it,
+ * so that no block index entry referring to the missing data is written.
+ */
+class CBlockFileWriter
+{
+private:
+    struct Job {
+        enum Type { BLOCK, UNDO, FLUSH } type;
+        //! Position of the header in front of the data, or the file to flush
+        CDiskBlockPos pos;
+        std::shared_ptr<const CBlock> block;
+        CBlockUndo undo;
+        uint256 hashPrevBlock;
+        bool fFinalize;
+        unsigned int nBlockFileSize;
+        unsigned int nUndoFileSize;
+        //! Size of the data counted against nBlockWriteQueueSize
+        size_t nBytes;
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condQueued;
+    boost::condition_variable condDone;
+    std::deque<Job> queue;
+    size_t nQueuedBytes = 0;
+    bool fRunning = false;
+    bool fBusy = false;
+    bool fFailed = false;
+    BlockFileWriterStats stats;
+    //! Type, file and position of the data of the queued writes
+    std::multiset<std::tuple<int, int, unsigned int>> setPending;
+
+    static std::tuple<int, int, unsigned int> PendingKey(Job::Type type, const CDiskBlockPos& pos)
+    {
+        // Reads use the position after the header
+        return std::make_tuple((int)type, pos.nFile, pos.nPos + 8);
+    }
+
+    static bool Run(const Job& job)
+    {
+        const CChainParams& chainparams = Params();
+        CDiskBlockPos pos = job.pos;
+        if (job.type == Job::BLOCK) {
+            if (!WriteBlockToDisk(*job.block, pos, chainparams.MessageStart())) {
+                return AbortNode("Failed to write block");
+            }
+        } else if (job.type == Job::UNDO) {
+            if (!UndoWriteToDisk(job.undo, pos, job.hashPrevBlock, chainparams.MessageStart())) {
+                return AbortNode("Failed to write undo data");
+            }
+        } else {
+            CommitBlockFiles(job.pos.nFile, job.fFinalize, job.nBlockFileSize, job.nUndoFileSize);
+        }
+        return true;
+    }
+
+    //! Record the outcome of a job that ran, with mutex held
+    void Done(bool fOk)
+    {
+        if (!fOk) {
+            fFailed = true;
+            stats.nFailed++;
+        }
+    }
+
+    void Finish(const Job& job)
+    {
+        nQueuedBytes -= job.nBytes;
+        if (job.type != Job::FLUSH) {
+            setPending.erase(setPending.find(PendingKey(job.type, job.pos)));
+        }
+        condDone.notify_all();
+    }
+
+    void Add(Job&& job)
+    {
+        boost::this_thread::disable_interruption no_interruption;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fRunning) {
+            Done(Run(job));
+            return;
+        }
+        // Wait for room, unless the queue is empty
+        while (nQueuedBytes > 0 && nQueuedBytes + job.nBytes > nBlockWriteQueueSize) {
+            condDone.wait(lock);
+        }
+        if (job.type != Job::FLUSH) {
+            setPending.insert(PendingKey(job.type, job.pos));
+        }
+        nQueuedBytes += job.nBytes;
+        stats.nQueued++;
+        queue.push_back(std::move(job));
+        condQueued.notify_one();
+    }
+
+public:
+    void WriteBlock(const std::shared_ptr<const CBlock>& block, const CDiskBlockPos& pos, size_t nSize)
+    {
+        Job job;
+        job.type = Job::BLOCK;
+        job.pos = pos;
+        job.block = block;
+        job.nBytes = nSize;
+        Add(std::move(job));
+    }
+
+    void WriteUndo(CBlockUndo&& undo, const CDiskBlockPos& pos, const uint256& hashPrevBlock, size_t nSize)
+    {
+        Job job;
+        job.type = Job::UNDO;
+        job.pos = pos;
+        job.undo = std::move(undo);
+        job.hashPrevBlock = hashPrevBlock;
+        job.nBytes = nSize;
+        Add(std::move(job));
+    }
+
+    void Flush(int nFile, bool fFinalize, unsigned int nBlockFileSize, unsigned int nUndoFileSize)
+    {
+        Job job;
+        job.type = Job::FLUSH;
+        job.pos = CDiskBlockPos(nFile, 0);
+        job.fFinalize = fFinalize;
+        job.nBlockFileSize = nBlockFileSize;
+        job.nUndoFileSize = nUndoFileSize;
+        job.nBytes = 0;
+        Add(std::move(job));
+    }
+
+    //! Wait until all queued jobs are done, and return false if any write failed
+    bool Wait()
+    {
+        boost::this_thread::disable_interruption no_interruption;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!queue.empty() || fBusy) {
+            condDone.wait(lock);
+        }
+        return !fFailed;
+    }
+
+    //! Forget a failed write, once no block index entry can refer to its data
+    void ClearFailure()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fFailed = false;
+    }
+
+    BlockFileWriterStats GetStats()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return stats;
+    }
+
+    //! Wait until the block (or undo data) at pos is written
+    void WaitForData(bool fUndo, const CDiskBlockPos& pos)
+    {
+        boost::this_thread::disable_interruption no_interruption;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        const auto key = std::make_tuple((int)(fUndo ? Job::UNDO : Job::BLOCK), pos.nFile, pos.nPos);
+        while (setPending.count(key)) {
+            condDone.wait(lock);
+        }
+    }
+
+    void Thread()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = true;
+        try {
+            while (true) {
+                while (queue.empty()) {
+                    condQueued.wait(lock);
+                }
+                Job job = std::move(queue.front());
+                queue.pop_front();
+                fBusy = true;
+                lock.unlock();
+                bool fOk = Run(job);
+                lock.lock();
+                fBusy = false;
+                Done(fOk);
+                Finish(job);
+            }
+        } catch (const boost::thread_interrupted&) {
+            // Write what is left before stopping
+            fRunning = false;
+            while (!queue.empty()) {
+                Done(Run(queue.front()));
+                Finish(queue.front());
+                queue.pop_front();
+            }
+            throw;
+        }
+    }
+};
+
+static CBlockFileWriter blockfilewriter;
+
+void ThreadBlockFileWriter() {
+    RenameThread("kusacoin-blkwrite");
+    blockfilewriter.Thread();
+}
+
+static void WaitForBlockFileData(bool fUndo, const CDiskBlockPos& pos) {
+    blockfilewriter.WaitForData(fUndo, pos);
+}
+
+BlockFileWriterStats GetBlockFileWriterStats()
+{
+    return blockfilewriter.GetStats();
+}
+
 /**
  * Restore the UTXO in a Coin at a given COutPoint
  * @param undo The Coin to be restored.
@@ -1612,16 +1992,14 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-void static FlushBlockFile(bool fFinalize = false)
+static void CommitBlockFiles(int nFile, bool fFinalize, unsigned int nBlockFileSize, unsigned int nUndoFileSize)
 {
-    LOCK(cs_LastBlockFile);
-
-    CDiskBlockPos posOld(nLastBlockFile, 0);
+    CDiskBlockPos posOld(nFile, 0);
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+            TruncateFile(fileOld, nBlockFileSize);
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1629,25 +2007,33 @@ void static FlushBlockFile(bool fFinalize = false)
     fileOld = OpenUndoFile(posOld);
     if (fileOld) {
         if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
+            TruncateFile(fileOld, nUndoFileSize);
         FileCommit(fileOld);
         fclose(fileOld);
     }
 }
 
+/** Queue a flush of the last block file, after the writes queued so far */
+void static FlushBlockFile(bool fFinalize = false)
+{
+    LOCK(cs_LastBlockFile);
+    blockfilewriter.Flush(nLastBlockFile, fFinalize, vinfoBlockFile[nLastBlockFile].nSize, vinfoBlockFile[nLastBlockFile].nUndoSize);
+}
+
 static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState& state, CBlockIndex* pindex, const CChainParams& chainparams)
+static bool WriteUndoDataForBlock(CBlockUndo&& blockundo, CValidationState& state, CBlockIndex* pindex, const CChainParams& chainparams)
 {
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
         CDiskBlockPos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+        unsigned int nSize = ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40;
+        if (!FindUndoPos(state, pindex->nFile, _pos, nSize))
             return error("ConnectBlock(): FindUndoPos failed");
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
-            return AbortNode(state, "Failed to write undo data");
+        blockfilewriter.WriteUndo(std::move(blockundo), _pos, pindex->pprev->GetBlockHash(), nSize);
 
-        // update nUndoPos in block index
+        // update nUndoPos in block index, the data follows the message start and size
+        _pos.nPos += 8;
         pindex->nUndoPos = _pos.nPos;
         pindex->nStatus |= BLOCK_HAVE_UNDO;
         setDirtyBlockIndex.insert(pindex);
@@ -1683,6 +2069,130 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/** Reads the coin spent by one input from the database */
+class CCoinsPrefetchCheck
+{
+private:
+    const CCoinsView *view;
+    COutPoint outpoint;
+    Coin *coin;
+
+public:
+    CCoinsPrefetchCheck() : view(nullptr), coin(nullptr) {}
+    CCoinsPrefetchCheck(const CCoinsView& viewIn, const COutPoint& outpointIn, Coin& coinIn) : view(&viewIn), outpoint(outpointIn), coin(&coinIn) {}
+
+    bool operator()() {
+        try {
+            view->GetCoin(outpoint, *coin);
+        } catch (const std::runtime_error& e) {
+            // Leave it to ConnectBlock to read the coin again and handle the error
+            coin->Clear();
+        }
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck& check) {
+        std::swap(view, check.view);
+        std::swap(outpoint, check.outpoint);
+        std::swap(coin, check.coin);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetchCheck> prefetchqueue(16);
+static CoinsPrefetchStats prefetchstats; // Protected by cs_main
+
+void ThreadCoinsPrefetch() {
+    RenameThread("kusacoin-prefetch");
+    prefetchqueue.Thread();
+}
+
+CoinsPrefetchStats GetCoinsPrefetchStats()
+{
+    LOCK(cs_main);
+    return prefetchstats;
+}
+
+/**
+ * Read the coins spent by a block that is about to be connected from the
+ * database into pcoinsTip, on several threads and without holding cs_main.
+ * ConnectBlock then finds them in the cache instead of reading them one
+ * after the other.
+ */
+static void PrefetchBlockCoins(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockNotHeld(cs_main);
+    if (!fPrefetchCoins || !nScriptCheckThreads || !pindex || block.vtx.size() < 2) {
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    const CCoinsViewDB* pdbview;
+    uint64_t nWriteCount;
+    std::vector<COutPoint> vOutpoints;
+    size_t nHits = 0;
+    {
+        LOCK(cs_main);
+        if (pindex->pprev != chainActive.Tip()) {
+            return;
+        }
+        pdbview = pcoinsdbview.get();
+        nWriteCount = pdbview->GetWriteCount();
+        // Inputs spending outputs of the block itself are not in the database
+        std::set<uint256> setBlockTxids;
+        for (const auto& tx : block.vtx) {
+            setBlockTxids.insert(tx->GetHash());
+        }
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            for (const CTxIn& txin : block.vtx[i]->vin) {
+                if (setBlockTxids.count(txin.prevout.hash)) {
+                    continue;
+                }
+                if (pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                    nHits++;
+                } else {
+                    vOutpoints.push_back(txin.prevout);
+                }
+            }
+        }
+    }
+
+    std::vector<Coin> vCoins(vOutpoints.size());
+    if (!vOutpoints.empty()) {
+        std::vector<CCoinsPrefetchCheck> vChecks;
+        vChecks.reserve(vOutpoints.size());
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            vChecks.emplace_back(*pdbview, vOutpoints[i], vCoins[i]);
+        }
+        CCheckQueueControl<CCoinsPrefetchCheck> control(&prefetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    LOCK(cs_main);
+    prefetchstats.nBlocks++;
+    prefetchstats.nHits += nHits;
+    if (pcoinsdbview.get() != pdbview || pdbview->GetWriteCount() != nWriteCount) {
+        // What was read may already be outdated
+        prefetchstats.nStale += vOutpoints.size();
+    } else {
+        // Entries that were added to the cache meanwhile are newer, and are kept
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            if (vCoins[i].IsSpent()) {
+                prefetchstats.nNotFound++;
+            } else if (pcoinsTip->EmplaceCoinFromBase(vOutpoints[i], std::move(vCoins[i]))) {
+                prefetchstats.nMisses++;
+            } else {
+                prefetchstats.nHits++;
+            }
+        }
+    }
+    int64_t nTime = GetTimeMicros() - nTimeStart;
+    prefetchstats.nTime += nTime;
+    LogPrint(BCLog::BENCH, "  - Prefetch coins: %.2fms, %u cached, %u read [%.2fs, %u cached, %u read, %u not found, %u stale]\n",
+        nTime * MILLI, (unsigned)nHits, (unsigned)vOutpoints.size(), prefetchstats.nTime * MICRO,
+        prefetchstats.nHits, prefetchstats.nMisses, prefetchstats.nNotFound, prefetchstats.nStale);
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1921,7 +2431,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (fJustCheck)
         return true;
 
-    if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
+    if (!WriteUndoDataForBlock(std::move(blockundo), state, pindex, chainparams))
         return false;
 
     if (!pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
@@ -1991,7 +2501,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastSetChain = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // Memory of evicted entries stays with the cache's pool and is reused
+        // for new entries before the pool grows, so only count what is in use
+        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() - pcoinsTip->FreeMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -2010,6 +2522,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                 return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
             FlushBlockFile();
+            if (!blockfilewriter.Wait())
+                return state.Error("Failed to write block files");
             // Then update all block file information (which may refer to block and undo files).
             {
                 std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -2043,8 +2557,17 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
-                return AbortNode(state, "Failed to write to coin database");
+            if (nCoinCacheKeepUsage == 0) {
+                if (!pcoinsTip->Flush())
+                    return AbortNode(state, "Failed to write to coin database");
+            } else {
+                // Write the changes, but keep the cache warm. Only enough
+                // unmodified coins are dropped to make room for new ones.
+                if (!pcoinsTip->Sync())
+                    return AbortNode(state, "Failed to write to coin database");
+                size_t nEvicted = pcoinsTip->EvictClean(nCoinCacheKeepUsage);
+                LogPrint(BCLog::COINDB, "Kept %u coins in the cache (%.1fMiB), evicted %u\n", pcoinsTip->GetCacheSize(), (pcoinsTip->DynamicMemoryUsage() - pcoinsTip->FreeMemoryUsage()) * (1.0 / 1024 / 1024), nEvicted);
+            }
             nLastFlush = nNow;
         }
     }
@@ -2059,10 +2582,10 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
     return true;
 }
 
-void FlushStateToDisk() {
+bool FlushStateToDisk() {
     CValidationState state;
     const CChainParams& chainparams = Params();
-    FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS);
+    return FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS);
 }
 
 void PruneAndFlush() {
@@ -2524,6 +3047,7 @@ bool CChainState::ActivateBestChain(CValidationState &state, const CChainParams&
     CBlockIndex *pindexMostWork = nullptr;
     CBlockIndex *pindexNewTip = nullptr;
     int nStopAtHeight = gArgs.GetArg("-stopatheight", DEFAULT_STOPATHEIGHT);
+    int nMaxConnectHeight = gArgs.GetArg("-maxconnectheight", DEFAULT_MAXCONNECTHEIGHT);
     do {
         boost::this_thread::interruption_point();
 
@@ -2545,6 +3069,10 @@ bool CChainState::ActivateBestChain(CValidationState &state, const CChainParams&
 
                 if (pindexMostWork == nullptr) {
                     pindexMostWork = FindMostWorkChain();
+                    // Keep received blocks above -maxconnectheight unconnected, e.g. to load a UTXO snapshot on top of them
+                    if (nMaxConnectHeight && pindexMostWork && pindexMostWork->nHeight > nMaxConnectHeight) {
+                        pindexMostWork = nMaxConnectHeight > chainActive.Height() ? pindexMostWork->GetAncestor(nMaxConnectHeight) : chainActive.Tip();
+                    }
                 }
 
                 // Whether we have anything to do at all.
@@ -2742,10 +3270,9 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return g_chainstate.ResetBlockFailureFlags(pindex);
 }
 
-CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, const uint256& hash)
 {
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
@@ -2910,10 +3437,10 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(hash, block.nBits, consensusParams))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
@@ -2928,7 +3455,8 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    // Only hash the header when the proof of work is actually checked
+    if (!CheckBlockHeader(block, fCheckPOW ? block.GetHash() : uint256(), state, consensusParams, fCheckPOW))
         return false;
 
     // Check the merkle root.
@@ -3161,11 +3689,11 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
+    assert(!fCheckBlockIndex || hash == block.GetHash());
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3180,7 +3708,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, hash, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3210,7 +3738,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
         }
     }
     if (pindex == nullptr)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3221,14 +3749,16 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 }
 
 // Exposed wrapper for AcceptBlockHeader
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid, const std::vector<uint256>* header_hashes)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+    assert(header_hashes == nullptr || header_hashes->size() == headers.size());
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, header_hashes ? (*header_hashes)[i] : header.GetHash(), state, chainparams, &pindex)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3242,7 +3772,8 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CChainParams& chainparams, const CDiskBlockPos* dbp) {
+static CDiskBlockPos SaveBlockToDisk(const std::shared_ptr<const CBlock>& pblock, int nHeight, const CChainParams& chainparams, const CDiskBlockPos* dbp) {
+    const CBlock& block = *pblock;
     unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
     CDiskBlockPos blockPos;
     if (dbp != nullptr)
@@ -3252,10 +3783,9 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
         return CDiskBlockPos();
     }
     if (dbp == nullptr) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
-            AbortNode("Failed to write block");
-            return CDiskBlockPos();
-        }
+        blockfilewriter.WriteBlock(pblock, blockPos, nBlockSize + 8);
+        // The block follows the message start and size
+        blockPos.nPos += 8;
     }
     return blockPos;
 }
@@ -3271,7 +3801,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, block.GetHash(), state, chainparams, &pindex))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3323,7 +3853,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
 
     // Write block to history file
     try {
-        CDiskBlockPos blockPos = SaveBlockToDisk(block, pindex->nHeight, chainparams, dbp);
+        CDiskBlockPos blockPos = SaveBlockToDisk(pblock, pindex->nHeight, chainparams, dbp);
         if (blockPos.IsNull()) {
             state.Error(strprintf("%s: Failed to find position to write new block to disk", __func__));
             return false;
@@ -3346,8 +3876,8 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 {
     AssertLockNotHeld(cs_main);
 
+    CBlockIndex *pindex = nullptr;
     {
-        CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
         CValidationState state;
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
@@ -3368,6 +3898,8 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
     NotifyHeaderTip();
 
+    PrefetchBlockCoins(*pblock, pindex);
+
     CValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!g_chainstate.ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed", __func__);
@@ -3453,6 +3985,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockfilemaps.Remove(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3619,7 +4152,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }))
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }, fCheckBlockIndexHashes, nScriptCheckThreads))
         return false;
 
     boost::this_thread::interruption_point();
@@ -3800,6 +4333,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (!(pindex->nStatus & BLOCK_HAVE_UNDO)) {
+            // Blocks up to a loaded UTXO snapshot were never connected.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (no undo data)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -3949,6 +4487,24 @@ bool ReplayBlocks(const CChainParams& params, CCoinsView* view) {
     return g_chainstate.ReplayBlocks(params, view);
 }
 
+/**
+ * Make pindex the tip after the coins database was replaced with the UTXO set
+ * after it. The blocks since the old tip, which must be an ancestor of pindex,
+ * are treated as connected and marked BLOCK_ASSUMED_VALID.
+ */
+void CChainState::SetSnapshotTip(const CChainParams& params, CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    for (CBlockIndex* pindexWalk = pindex; pindexWalk != chainActive.Tip(); pindexWalk = pindexWalk->pprev) {
+        pindexWalk->nStatus |= BLOCK_ASSUMED_VALID;
+        setDirtyBlockIndex.insert(pindexWalk);
+    }
+    chainActive.SetTip(pindex);
+    setBlockIndexCandidates.insert(pindex);
+    PruneBlockIndexCandidates();
+    CheckBlockIndex(params.GetConsensus());
+}
+
 bool CChainState::RewindBlockIndex(const CChainParams& params)
 {
     LOCK(cs_main);
@@ -4084,6 +4640,7 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    blockfilewriter.ClearFailure();
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4126,10 +4683,10 @@ bool CChainState::LoadGenesisBlock(const CChainParams& chainparams)
 
     try {
         CBlock &block = const_cast<CBlock&>(chainparams.GenesisBlock());
-        CDiskBlockPos blockPos = SaveBlockToDisk(block, 0, chainparams, nullptr);
+        CDiskBlockPos blockPos = SaveBlockToDisk(std::make_shared<const CBlock>(block), 0, chainparams, nullptr);
         if (blockPos.IsNull())
             return error("%s: writing genesis block to disk failed", __func__);
-        CBlockIndex *pindex = AddToBlockIndex(block);
+        CBlockIndex *pindex = AddToBlockIndex(block, block.GetHash());
         CValidationState state;
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos, chainparams.GetConsensus()))
             return error("%s: genesis block not accepted", __func__);
@@ -4310,8 +4867,8 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindexFirstNeverProcessed == nullptr && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != nullptr && pindexFirstNotTreeValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
         if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
-        if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && !(pindex->nStatus & BLOCK_ASSUMED_VALID) && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
+        if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && !(pindex->nStatus & BLOCK_ASSUMED_VALID) && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
 
         // Begin: actual consistency checks.
         if (pindex->pprev == nullptr) {
@@ -4605,6 +5162,266 @@ bool DumpMempool(void)
     return true;
 }
 
+/*
+ * A UTXO set snapshot starts with a magic string, the format version, the
+ * network's message start characters, the hash of the block after which the
+ * coins are the UTXO set, and the number of coins. The coins follow grouped by
+ * txid: the txid, the number of its coins, and VARINT(n) and the Coin for each
+ * of them. The file ends with the hash of everything before it.
+ */
+static const unsigned char UTXO_SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+static const uint16_t UTXO_SNAPSHOT_VERSION = 1;
+
+/** Reads a UTXO set snapshot, throwing on any inconsistency. */
+class CUTXOSnapshotReader
+{
+private:
+    CAutoFile file;
+    CHashVerifier<CAutoFile> verifier;
+    uint64_t nCoins = 0;
+    uint64_t nRead = 0;
+    uint256 txid;
+    uint64_t nLeftInGroup = 0;
+    uint256 hashFile;
+
+public:
+    explicit CUTXOSnapshotReader(const fs::path& path) : file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION), verifier(&file)
+    {
+        if (file.IsNull()) {
+            throw std::runtime_error("unable to open " + path.string());
+        }
+    }
+
+    void ReadHeader(UTXOSnapshotInfo& info)
+    {
+        unsigned char magic[sizeof(UTXO_SNAPSHOT_MAGIC)];
+        uint16_t version;
+        CMessageHeader::MessageStartChars message_start;
+        verifier >> FLATDATA(magic) >> version >> FLATDATA(message_start);
+        if (memcmp(magic, UTXO_SNAPSHOT_MAGIC, sizeof(magic))) {
+            throw std::runtime_error("not a UTXO set snapshot");
+        }
+        if (version != UTXO_SNAPSHOT_VERSION) {
+            throw std::runtime_error(strprintf("unknown version %u", version));
+        }
+        if (memcmp(message_start, Params().MessageStart(), sizeof(message_start))) {
+            throw std::runtime_error("the snapshot is for a different network");
+        }
+        verifier >> info.hashBlock >> nCoins;
+        info.nCoins = nCoins;
+    }
+
+    //! Read the next coin. After the last one, check the hash at the end and return false.
+    bool Next(COutPoint& outpoint, Coin& coin)
+    {
+        if (nRead == nCoins) {
+            file >> hashFile;
+            if (hashFile != verifier.GetHash()) {
+                throw std::runtime_error("checksum mismatch");
+            }
+            return false;
+        }
+        if (nLeftInGroup == 0) {
+            verifier >> txid;
+            nLeftInGroup = ReadCompactSize(verifier);
+            if (nLeftInGroup == 0 || nLeftInGroup > nCoins - nRead) {
+                throw std::runtime_error("invalid number of coins");
+            }
+        }
+        outpoint.hash = txid;
+        verifier >> VARINT(outpoint.n) >> coin;
+        if (coin.IsSpent()) {
+            throw std::runtime_error("spent coin");
+        }
+        nLeftInGroup--;
+        nRead++;
+        return true;
+    }
+
+    //! The checked hash of the file, once all coins were read
+    uint256 GetHash() const { return hashFile; }
+};
+
+template<typename Stream>
+static void WriteSnapshotCoins(Stream& s, const uint256& txid, const std::vector<std::pair<uint32_t, Coin>>& coins)
+{
+    s << txid;
+    WriteCompactSize(s, coins.size());
+    for (const auto& coin : coins) {
+        uint32_t n = coin.first;
+        s << VARINT(n) << coin.second;
+    }
+}
+
+bool DumpUTXOSnapshot(const fs::path& path, UTXOSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMicros();
+    if (fs::exists(path)) {
+        strError = path.string() + " already exists";
+        return false;
+    }
+
+    // One cursor counts the coins for the header, the other writes them.
+    // Both see the database as of the same block.
+    std::unique_ptr<CCoinsViewCursor> pcounter;
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    {
+        LOCK(cs_main);
+        if (!FlushStateToDisk()) {
+            strError = "Failed to write the chain state to disk";
+            return false;
+        }
+        pcounter.reset(pcoinsdbview->Cursor());
+        pcursor.reset(pcoinsdbview->Cursor());
+        info.hashBlock = pcursor->GetBestBlock();
+        info.nHeight = mapBlockIndex.at(info.hashBlock)->nHeight;
+    }
+    info.nCoins = 0;
+    for (; pcounter->Valid(); pcounter->Next()) {
+        boost::this_thread::interruption_point();
+        info.nCoins++;
+    }
+
+    const fs::path pathTmp = path.string() + ".incomplete";
+    try {
+        FILE* filestr = fsbridge::fopen(pathTmp, "wb");
+        if (!filestr) {
+            strError = "Unable to open " + pathTmp.string();
+            return false;
+        }
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        CHashedWriter<CAutoFile> writer(&file);
+        writer << FLATDATA(UTXO_SNAPSHOT_MAGIC) << UTXO_SNAPSHOT_VERSION << FLATDATA(Params().MessageStart());
+        writer << info.hashBlock << info.nCoins;
+
+        uint64_t nWritten = 0;
+        uint256 txid;
+        std::vector<std::pair<uint32_t, Coin>> coins;
+        for (; pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                throw std::runtime_error("unable to read the UTXO set");
+            }
+            if (key.hash != txid && !coins.empty()) {
+                WriteSnapshotCoins(writer, txid, coins);
+                coins.clear();
+            }
+            txid = key.hash;
+            coins.emplace_back(key.n, std::move(coin));
+            nWritten++;
+        }
+        if (!coins.empty()) {
+            WriteSnapshotCoins(writer, txid, coins);
+        }
+        if (nWritten != info.nCoins) {
+            throw std::runtime_error("the UTXO set changed while it was written");
+        }
+        info.hashFile = writer.GetHash();
+        file << info.hashFile;
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        fs::remove(pathTmp);
+        strError = strprintf("Failed to write UTXO snapshot: %s", e.what());
+        return false;
+    }
+    if (!RenameOver(pathTmp, path)) {
+        strError = "Unable to rename " + pathTmp.string();
+        return false;
+    }
+    LogPrintf("Dumped UTXO snapshot of %u coins at height %d: %gs\n", info.nCoins, info.nHeight, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, UTXOSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMicros();
+    COutPoint outpoint;
+    Coin coin;
+
+    // Check the whole file before the coins database is touched
+    try {
+        CUTXOSnapshotReader reader(path);
+        reader.ReadHeader(info);
+        while (reader.Next(outpoint, coin)) {
+            boost::this_thread::interruption_point();
+        }
+        info.hashFile = reader.GetHash();
+    } catch (const std::exception& e) {
+        strError = strprintf("Invalid UTXO snapshot: %s", e.what());
+        return false;
+    }
+    // Its coins are not checked against the blocks, so only accept snapshots
+    // the chain parameters commit to
+    const MapUTXOSnapshots& snapshots = chainparams.UTXOSnapshots();
+    MapUTXOSnapshots::const_iterator itSnapshot = snapshots.find(info.hashBlock);
+    if (itSnapshot == snapshots.end()) {
+        strError = "Unknown UTXO snapshot block " + info.hashBlock.ToString();
+        return false;
+    }
+    if (itSnapshot->second != info.hashFile) {
+        strError = "UTXO snapshot hash mismatch, expected " + itSnapshot->second.ToString();
+        return false;
+    }
+
+    LOCK(cs_main);
+    if (fTxIndex || fImporting || fReindex) {
+        strError = "A UTXO snapshot cannot be loaded with -txindex or while importing blocks";
+        return false;
+    }
+    BlockMap::iterator it = mapBlockIndex.find(info.hashBlock);
+    if (it == mapBlockIndex.end() || it->second->nChainTx == 0 || (it->second->nStatus & BLOCK_FAILED_MASK)) {
+        strError = "The block of the snapshot and its ancestors have to be received first";
+        return false;
+    }
+    CBlockIndex* pindex = it->second;
+    if (pindex->nHeight <= chainActive.Height() || pindex->GetAncestor(chainActive.Height()) != chainActive.Tip()) {
+        strError = "The block of the snapshot does not extend the active chain";
+        return false;
+    }
+    info.nHeight = pindex->nHeight;
+
+    // From here on a failure leaves the coins database half written, which
+    // is repaired at the next startup.
+    if (!FlushStateToDisk()) {
+        strError = "Failed to write the chain state to disk";
+        return false;
+    }
+    if (!pcoinsTip->Flush()) {
+        strError = "Failed to write to coin database";
+        return AbortNode(strError);
+    }
+    try {
+        CUTXOSnapshotReader reader(path);
+        UTXOSnapshotInfo info_reread;
+        reader.ReadHeader(info_reread);
+        if (info_reread.hashBlock != info.hashBlock ||
+                !pcoinsdbview->ReplaceCoins(info.hashBlock, [&reader](COutPoint& outpoint, Coin& coin) { return reader.Next(outpoint, coin); })) {
+            strError = "Failed to write the UTXO snapshot to the coin database";
+            return AbortNode(strError);
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to load UTXO snapshot: %s", e.what());
+        return AbortNode(strError);
+    }
+    pcoinsTip->SetBestBlock(info.hashBlock);
+
+    CBlockIndex* pindexOld = chainActive.Tip();
+    g_chainstate.SetSnapshotTip(chainparams, pindex);
+    // The mempool was valid for the old tip
+    mempool.clear();
+    if (!FlushStateToDisk()) {
+        strError = "Failed to write the chain state after loading the UTXO snapshot";
+        return AbortNode(strError);
+    }
+    GetMainSignals().UpdatedBlockTip(pindex, pindexOld, IsInitialBlockDownload());
+    LogPrintf("Loaded UTXO snapshot of %u coins, new tip %s at height %d: %gs\n", info.nCoins,
+        pindex->GetBlockHash().ToString(), pindex->nHeight, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
     if (pindex == nullptr)
@@ -131,7 +131,15 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkblockindexhashes */
+static const bool DEFAULT_CHECKBLOCKINDEXHASHES = false;
 static const bool DEFAULT_TXINDEX = false;
+/** Default for -prefetchcoins */
+static const bool DEFAULT_PREFETCH_COINS = true;
+/** Default for -blockwritequeue, in MiB */
+static const unsigned int DEFAULT_BLOCK_WRITE_QUEUE = 32;
+/** Default for -blockmmap, the number of block files kept mapped */
+static const unsigned int DEFAULT_BLOCK_MMAP_FILES = 0;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -150,6 +158,8 @@ static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
+/** Default for -maxconnectheight */
+static const int DEFAULT_MAXCONNECTHEIGHT = 0;
 
 struct BlockHasher
 {
@@ -171,12 +181,20 @@ extern uint256 hashBestBlock;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+/** Maximum size of the block and undo data waiting to be written, 0 to write it synchronously */
+extern size_t nBlockWriteQueueSize;
+/** Number of block files to keep memory mapped for reading blocks, 0 to read them with stdio */
+extern unsigned int nBlockMapFiles;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
+extern bool fCheckBlockIndexHashes;
 extern bool fCheckpointsEnabled;
+extern bool fPrefetchCoins;
 extern size_t nCoinCacheUsage;
+/** Usage the coins cache is trimmed to when written out, instead of emptying it (0 to empty it) */
+extern size_t nCoinCacheKeepUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in tanakas) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -253,8 +271,9 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  * @param[in]  chainparams The params for the chain we want to connect to
  * @param[out] ppindex If set, the pointer will be set to point to the last new block index object for the given headers
  * @param[out] first_invalid First header that fails validation, if one exists
+ * @param[in]  header_hashes If set, the hashes of the given headers (as computed by CBlockHeader::GetHash()), so they need not be hashed again
  */
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex=nullptr, CBlockHeader *first_invalid=nullptr);
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex=nullptr, CBlockHeader *first_invalid=nullptr, const std::vector<uint256>* header_hashes=nullptr);
 
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
@@ -275,6 +294,38 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the thread reading the coins of new blocks ahead of connecting them */
+void ThreadCoinsPrefetch();
+/** Run the thread appending blocks and undo data to the block files */
+void ThreadBlockFileWriter();
+
+/** Counters of the coins read ahead for blocks about to be connected */
+struct CoinsPrefetchStats
+{
+    //! Blocks whose coins were prefetched
+    uint64_t nBlocks = 0;
+    //! Inputs that were already in the coins cache
+    uint64_t nHits = 0;
+    //! Inputs that were read from the database into the cache
+    uint64_t nMisses = 0;
+    //! Inputs that were not found in the database
+    uint64_t nNotFound = 0;
+    //! Inputs that were read but thrown away, as the database was written to meanwhile
+    uint64_t nStale = 0;
+    //! Time spent reading, in microseconds
+    int64_t nTime = 0;
+};
+CoinsPrefetchStats GetCoinsPrefetchStats();
+
+/** Counters of the block file writer */
+struct BlockFileWriterStats
+{
+    //! Jobs queued for the writer thread, rather than run by the caller
+    uint64_t nQueued = 0;
+    //! Block and undo writes that failed
+    uint64_t nFailed = 0;
+};
+BlockFileWriterStats GetBlockFileWriterStats();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -300,7 +351,7 @@ void PruneOneBlockFile(const int fileNumber);
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
 /** Flush all state, indexes and buffers to disk. */
-void FlushStateToDisk();
+bool FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 /** Prune block files up to a given height */
@@ -399,6 +450,9 @@ void InitScriptExecutionCache();
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized bytes of a block, as they are on disk and on the wire, without deserializing or checking them */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -483,4 +537,29 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** What a UTXO set snapshot file contains */
+struct UTXOSnapshotInfo {
+    //! The block after which the coins are the UTXO set
+    uint256 hashBlock;
+    int nHeight = 0;
+    uint64_t nCoins = 0;
+    //! Hash of the file contents, stored at its end
+    uint256 hashFile;
+};
+
+/** Write the UTXO set after the current tip to a snapshot file. */
+bool DumpUTXOSnapshot(const fs::path& path, UTXOSnapshotInfo& info, std::string& strError);
+
+/**
+ * Replace the UTXO set with the one in a snapshot file, and make the block of
+ * the snapshot the tip. That block and its ancestors must have been received,
+ * and the current tip must be one of them: a snapshot cannot be loaded on top
+ * of headers only, so it saves validating the blocks, not downloading them.
+ * The blocks in between are not validated and get no undo data, so the chain
+ * cannot be reorganized to below the snapshot's block afterwards. Validation
+ * interface clients only see UpdatedBlockTip, not BlockConnected for the
+ * skipped blocks.
+ */
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, UTXOSnapshotInfo& info, std::string& strError);
+
 #endif // KUSACOIN_VALIDATION_H
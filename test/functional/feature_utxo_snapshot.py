@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Kusacoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumping and loading UTXO snapshots.
+
+- Mine 110 blocks on node0 and dump its UTXO set with dumptxoutset, then mine 10 more.
+- Let node1 receive all blocks, but only connect the first 100 (-maxconnectheight).
+- Check that node1 only loads the snapshot when it is given with -assumeutxo and
+  the file hash matches.
+- Load the snapshot on node1 and check that its UTXO set matches the one of node0.
+- Restart node1 without -maxconnectheight and check that it connects the blocks
+  after the snapshot.
+"""
+
+from test_framework.segwit_addr import encode
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error, connect_nodes, sync_blocks, wait_until
+
+# A P2WPKH address on regtest, the blocks pay to it without a wallet
+ADDRESS = encode("kusareg", 0, bytes(20))
+BASE_HEIGHT = 110
+
+def utxo_stats(node):
+    """The UTXO set statistics that do not depend on how the node stores it."""
+    stats = node.gettxoutsetinfo()
+    del stats["disk_size"]
+    return stats
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-disablewallet"], ["-disablewallet", "-maxconnectheight=100"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def restart_node1(self, extra_args):
+        self.stop_node(1)
+        self.start_node(1, ["-disablewallet"] + extra_args)
+
+    def run_test(self):
+        node0, node1 = self.nodes
+
+        self.log.info("Dump the UTXO set of node0")
+        node0.generatetoaddress(BASE_HEIGHT, ADDRESS)
+        utxo_info = utxo_stats(node0)
+        snapshot = node0.dumptxoutset("utxo.dat")
+        assert_equal(snapshot["base_hash"], node0.getbestblockhash())
+        assert_equal(snapshot["base_height"], BASE_HEIGHT)
+        assert_equal(snapshot["coins"], utxo_info["txouts"])
+        assert_raises_rpc_error(-1, "already exists", node0.dumptxoutset, "utxo.dat")
+        node0.generatetoaddress(10, ADDRESS)
+
+        self.log.info("Receive the blocks on node1 without connecting them")
+        connect_nodes(node1, 0)
+        wait_until(lambda: {"height": BASE_HEIGHT + 10, "hash": node0.getbestblockhash(), "branchlen": 20, "status": "valid-headers"} in node1.getchaintips(), timeout=60)
+        assert_equal(node1.getblockcount(), 100)
+
+        self.log.info("Only load snapshots given with -assumeutxo")
+        assert_raises_rpc_error(-1, "Unknown UTXO snapshot block", node1.loadtxoutset, snapshot["path"])
+        self.restart_node1(["-maxconnectheight=100", "-assumeutxo=%s:%s" % (snapshot["base_hash"], "00" * 32)])
+        assert_raises_rpc_error(-1, "UTXO snapshot hash mismatch", node1.loadtxoutset, snapshot["path"])
+        self.restart_node1(["-maxconnectheight=100", "-assumeutxo=%s:%s" % (snapshot["base_hash"], snapshot["checksum"])])
+        assert_equal(node1.getblockcount(), 100)
+
+        self.log.info("Load the snapshot on node1")
+        loaded = node1.loadtxoutset(snapshot["path"])
+        assert_equal(loaded, snapshot)
+        assert_equal(node1.getbestblockhash(), snapshot["base_hash"])
+        assert_equal(utxo_stats(node1), utxo_info)
+        assert_raises_rpc_error(-1, "does not extend the active chain", node1.loadtxoutset, snapshot["path"])
+
+        self.log.info("Connect the blocks after the snapshot")
+        self.restart_node1([])
+        connect_nodes(node1, 0)
+        sync_blocks(self.nodes)
+        assert_equal(utxo_stats(node1), utxo_stats(node0))
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
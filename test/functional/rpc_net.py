@@ -25,6 +25,7 @@ class NetTest(BitcoinTestFramework):
     def run_test(self):
         self._test_connection_count()
         self._test_getnettotals()
+        self._test_getnetstats()
         self._test_getnetworkinginfo()
         self._test_getaddednodeinfo()
         self._test_getpeerinfo()
@@ -63,6 +64,25 @@ class NetTest(BitcoinTestFramework):
             assert_greater_than_or_equal(after['bytesrecv_per_msg']['pong'], before['bytesrecv_per_msg']['pong'] + 32)
             assert_greater_than_or_equal(after['bytessent_per_msg']['ping'], before['bytessent_per_msg']['ping'] + 32)
 
+    def _test_getnetstats(self):
+        # every processed message is timed, per peer and in the totals
+        self.nodes[0].ping()
+        wait_until(lambda: all(peer['processtime_per_msg'].get('pong', {'count': 0})['count'] > 0 for peer in self.nodes[0].getpeerinfo()), timeout=1)
+        peer_info = self.nodes[0].getpeerinfo()
+        net_stats = self.nodes[0].getnetstats()
+
+        for peer in peer_info:
+            for histogram in list(peer['queuetime_per_msg'].values()) + list(peer['processtime_per_msg'].values()):
+                assert_equal(sum(histogram['buckets']), histogram['count'])
+                assert_greater_than_or_equal(histogram['total'], histogram['max'])
+            assert_greater_than_or_equal(peer['processtime_per_msg']['pong']['count'], peer['queuetime_per_msg']['pong']['count'])
+        for command, histogram in net_stats['processtime_per_msg'].items():
+            assert_greater_than_or_equal(histogram['count'], sum(peer['processtime_per_msg'].get(command, {'count': 0})['count'] for peer in peer_info))
+
+        assert_equal(len(net_stats['peers']), 2)
+        assert_greater_than_or_equal(net_stats['peers'][0]['processtime'], net_stats['peers'][1]['processtime'])
+        assert_equal(sorted(peer['id'] for peer in net_stats['peers']), sorted(peer['id'] for peer in peer_info))
+
     def _test_getnetworkinginfo(self):
         assert_equal(self.nodes[0].getnetworkinfo()['networkactive'], True)
         assert_equal(self.nodes[0].getnetworkinfo()['connections'], 2)